@@ -240,6 +240,7 @@ extern "C"
 
 // Functions
 extern void     SWJ_Sequence    (uint32_t count, const uint8_t *data);
+extern uint32_t SWJ_SetClock    (uint32_t clock);
 extern void     SWD_Sequence    (uint32_t info,  const uint8_t *swdo, uint8_t *swdi);
 extern void     JTAG_Sequence   (uint32_t info,  const uint8_t *tdi,  uint8_t *tdo);
 extern void     JTAG_IR         (uint32_t ir);
@@ -247,6 +248,11 @@ extern uint32_t JTAG_ReadIDCode (void);
 extern void     JTAG_WriteAbort (uint32_t data);
 extern uint8_t  JTAG_Transfer   (uint32_t request, uint32_t *data);
 extern uint8_t  SWD_Transfer    (uint32_t request, uint32_t *data);
+extern uint8_t  SWD_TransferRetry (uint32_t request, uint32_t *data);
+extern uint8_t  SWD_TransferBlind (uint32_t request, const uint8_t *data, uint32_t *count);
+extern uint32_t SWD_Submit        (uint32_t request, uint32_t data);
+extern uint8_t  SWD_Complete      (uint32_t slot, uint32_t *data);
+extern void     SWD_Configure     (void);
 
 extern void     Delayms         (uint32_t delay);
 
@@ -284,7 +290,7 @@ extern void     DAP_Setup (void);
 #ifndef DELAY_SLOW_CYCLES
 #define DELAY_SLOW_CYCLES       3U      // Number of cycles for one iteration
 #endif
-#if defined(__CC_ARM)
+#if defined(__CC_ARM) || !defined(__arm__)
 __STATIC_FORCEINLINE void PIN_DELAY_SLOW (uint32_t delay) {
   uint32_t count = delay;
   while (--count);
@@ -127,12 +127,12 @@ static uint8_t DAP_Info(uint8_t id, uint8_t *info) {
 #endif
       break;
     case DAP_ID_PACKET_SIZE:
-      info[0] = (uint8_t)(DAP_PACKET_SIZE >> 0);
-      info[1] = (uint8_t)(DAP_PACKET_SIZE >> 8);
+      info[0] = (uint8_t)(DAP_PACKET_SIZE_ACTIVE >> 0);
+      info[1] = (uint8_t)(DAP_PACKET_SIZE_ACTIVE >> 8);
       length = 2U;
       break;
     case DAP_ID_PACKET_COUNT:
-      info[0] = DAP_PACKET_COUNT - 2; // HACK to avoid ring buffer fullness
+      info[0] = DAP_PACKET_COUNT_ACTIVE - 2; // HACK to avoid ring buffer fullness
       length = 1U;
       break;
     default:
@@ -395,6 +395,8 @@ static uint32_t DAP_SWJ_Clock(const uint8_t *request, uint8_t *response) {
     DAP_Data.clock_delay = delay;
   }
 
+  SWJ_SetClock(clock);
+
   *response = DAP_OK;
 #else
   *response = DAP_ERROR;
@@ -442,6 +444,7 @@ static uint32_t DAP_SWD_Configure(const uint8_t *request, uint8_t *response) {
   value = *request;
   DAP_Data.swd_conf.turnaround = (value & 0x03U) + 1U;
   DAP_Data.swd_conf.data_phase = (value & 0x04U) ? 1U : 0U;
+  SWD_Configure();
   
   *response = DAP_OK;
 #else
@@ -642,6 +645,9 @@ static uint32_t DAP_TransferConfigure(const uint8_t *request, uint8_t *response)
                                   (uint16_t)(*(request+2) << 8);
   DAP_Data.transfer.match_retry = (uint16_t) *(request+3) | 
                                   (uint16_t)(*(request+4) << 8);
+#if (DAP_SWD != 0)
+  SWD_Configure();
+#endif
 
   *response = DAP_OK;
   return ((5U << 16) | 1U); 
@@ -654,6 +660,35 @@ static uint32_t DAP_TransferConfigure(const uint8_t *request, uint8_t *response)
 //   return:   number of bytes in response (lower 16 bits)
 //             number of bytes in request (upper 16 bits)
 #if (DAP_SWD != 0)
+
+// Plain register writes are posted to the SWD engine and only checked once
+// something needs their outcome: another kind of transfer, a full queue or
+// the end of the command.
+static struct {
+  uint32_t first;                               // Slot of the oldest
+  uint32_t count;                               // Writes posted
+  uint32_t response_count[SWD_QUEUE_DEPTH];     // Transfers done before each
+} swd_posted;
+
+// Check the posted writes
+//   response_count: rewound to the first write that failed
+//   return:         its ACK, or DAP_TRANSFER_OK
+static uint32_t DAP_SWD_Flush(uint32_t *response_count) {
+  uint32_t n;
+  uint8_t  ack;
+
+  for (n = 0U; n < swd_posted.count; n++) {
+    ack = SWD_Complete(swd_posted.first + n, NULL);
+    if (ack != DAP_TRANSFER_OK) {
+      *response_count = swd_posted.response_count[n];
+      swd_posted.count = 0U;
+      return ack;
+    }
+  }
+  swd_posted.count = 0U;
+  return DAP_TRANSFER_OK;
+}
+
 static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
   const
   uint8_t  *request_head;
@@ -666,8 +701,8 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
   uint32_t  check_write;
   uint32_t  match_value;
   uint32_t  match_retry;
-  uint32_t  retry;
   uint32_t  data;
+  uint32_t  slot;
 #if (TIMESTAMP_CLOCK != 0U)
   uint32_t  timestamp;
 #endif
@@ -683,6 +718,7 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
 
   post_read   = 0U;
   check_write = 0U;
+  swd_posted.count = 0U;
 
   request++;            // Ignore DAP index
 
@@ -690,21 +726,24 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
 
   for (; request_count != 0U; request_count--) {
     request_value = *request++;
+    if ((request_value & (DAP_TRANSFER_RnW | DAP_TRANSFER_MATCH_MASK | DAP_TRANSFER_TIMESTAMP)) != 0U) {
+      // Not a plain write - the posted writes have to have gone through
+      response_value = DAP_SWD_Flush(&response_count);
+      if (response_value != DAP_TRANSFER_OK) {
+        request--;
+        break;
+      }
+    }
     if ((request_value & DAP_TRANSFER_RnW) != 0U) {
       // Read register
       if (post_read) {
         // Read was posted before
-        retry = DAP_Data.transfer.retry_count;
         if ((request_value & (DAP_TRANSFER_APnDP | DAP_TRANSFER_MATCH_VALUE)) == DAP_TRANSFER_APnDP) {
           // Read previous AP data and post next AP read
-          do {
-            response_value = SWD_Transfer(request_value, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(request_value, &data);
         } else {
           // Read previous AP data
-          do {
-            response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
           post_read = 0U;
         }
         if (response_value != DAP_TRANSFER_OK) { 
@@ -738,20 +777,14 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
         match_retry = DAP_Data.transfer.match_retry;
         if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
           // Post AP read
-          retry = DAP_Data.transfer.retry_count;
-          do {
-            response_value = SWD_Transfer(request_value, NULL);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(request_value, NULL);
           if (response_value != DAP_TRANSFER_OK) {
             break;
           }
         }
         do {
           // Read register until its value matches or retry counter expires
-          retry = DAP_Data.transfer.retry_count;
-          do {
-            response_value = SWD_Transfer(request_value, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(request_value, &data);
           if (response_value != DAP_TRANSFER_OK) {
             break;
           }
@@ -764,14 +797,11 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
         }
       } else {
         // Normal read
-        retry = DAP_Data.transfer.retry_count;
         if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
           // Read AP register
           if (post_read == 0U) {
             // Post AP read
-            do {
-              response_value = SWD_Transfer(request_value, NULL);
-            } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+            response_value = SWD_TransferRetry(request_value, NULL);
             if (response_value != DAP_TRANSFER_OK) {
               break;
             }
@@ -789,9 +819,7 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
           }
         } else {
           // Read DP register
-          do {
-            response_value = SWD_Transfer(request_value, &data);
-          } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+          response_value = SWD_TransferRetry(request_value, &data);
           if (response_value != DAP_TRANSFER_OK) {
             break;
           }
@@ -817,10 +845,7 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
       // Write register
       if (post_read) {
         // Read previous data
-        retry = DAP_Data.transfer.retry_count;
-        do {
-          response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
-        } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+        response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
         if (response_value != DAP_TRANSFER_OK) {
           break;
         }
@@ -841,12 +866,24 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
         // Write match mask
         DAP_Data.transfer.match_mask = data;
         response_value = DAP_TRANSFER_OK;
+      } else if ((request_value & DAP_TRANSFER_TIMESTAMP) == 0U) {
+        // Post DP/AP register write
+        if (swd_posted.count == SWD_QUEUE_DEPTH) {
+          response_value = DAP_SWD_Flush(&response_count);
+          if (response_value != DAP_TRANSFER_OK) {
+            break;
+          }
+        }
+        slot = SWD_Submit(request_value, data);
+        if (swd_posted.count == 0U) {
+          swd_posted.first = slot;
+        }
+        swd_posted.response_count[swd_posted.count++] = response_count;
+        response_value = DAP_TRANSFER_OK;
+        check_write = 1U;
       } else {
         // Write DP/AP register
-        retry = DAP_Data.transfer.retry_count;
-        do {
-          response_value = SWD_Transfer(request_value, &data);
-        } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+        response_value = SWD_TransferRetry(request_value, &data);
         if (response_value != DAP_TRANSFER_OK) {
           break;
         }
@@ -884,13 +921,13 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
     }
   }
 
+  if (response_value == DAP_TRANSFER_OK) {
+    response_value = DAP_SWD_Flush(&response_count);
+  }
   if (response_value == DAP_TRANSFER_OK) {
     if (post_read) {
       // Read previous data
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+      response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, &data);
       if (response_value != DAP_TRANSFER_OK) {
         goto end;
       }
@@ -901,10 +938,7 @@ static uint32_t DAP_SWD_Transfer(const uint8_t *request, uint8_t *response) {
       *response++ = (uint8_t)(data >> 24);
     } else if (check_write) {
       // Check last write
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+      response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
     }
   }
 
@@ -1270,8 +1304,14 @@ static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response)
   uint32_t  response_count;
   uint32_t  response_value;
   uint8_t  *response_head;
-  uint32_t  retry;
   uint32_t  data;
+  uint32_t  blind_count;
+  uint32_t  post_read;
+  uint32_t  total;
+  uint32_t  submitted;
+  uint32_t  completed;
+  uint32_t  first;
+  uint32_t  slot;
 
   response_count = 0U;
   response_value = 0U;
@@ -1291,30 +1331,32 @@ static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response)
 
   request_value = *request++;
   if ((request_value & DAP_TRANSFER_RnW) != 0U) {
-    // Read register block
-    if ((request_value & DAP_TRANSFER_APnDP) != 0U) {
-      // Post AP read
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(request_value, NULL);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
-      if (response_value != DAP_TRANSFER_OK) {
-        goto end;
-      }
-    }
-    while (request_count--) {
-      // Read DP/AP register
-      if ((request_count == 0U) && ((request_value & DAP_TRANSFER_APnDP) != 0U)) {
-        // Last AP read
-        request_value = DP_RDBUFF | DAP_TRANSFER_RnW;
+    // Read register block, up to SWD_QUEUE_DEPTH reads in flight. AP reads
+    // are posted: the first returns nothing and RDBUFF ends the block.
+    post_read = ((request_value & DAP_TRANSFER_APnDP) != 0U) ? 1U : 0U;
+    total = request_count + post_read;
+    first = 0U;
+    for (submitted = completed = 0U; completed < total; completed++) {
+      for (; (submitted < total) && ((submitted - completed) < SWD_QUEUE_DEPTH); submitted++) {
+        if (post_read && (submitted == (total - 1U))) {
+          // Last AP read
+          slot = SWD_Submit(DP_RDBUFF | DAP_TRANSFER_RnW, 0U);
+        } else {
+          slot = SWD_Submit(request_value, 0U);
+        }
+        if (submitted == 0U) {
+          first = slot;
+        }
       }
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(request_value, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+      response_value = SWD_Complete(first + completed, &data);
       if (response_value != DAP_TRANSFER_OK) {
+        // Reads already on their way are finished, and dropped
+        SWD_Complete(first + submitted - 1U, NULL);
         goto end;
       }
+      if (post_read && (completed == 0U)) {
+        continue;
+      }
       // Store data
       *response++ = (uint8_t) data;
       *response++ = (uint8_t)(data >>  8);
@@ -1323,29 +1365,39 @@ static uint32_t DAP_SWD_TransferBlock(const uint8_t *request, uint8_t *response)
       response_count++;
     }
   } else {
-    // Write register block
-    while (request_count--) {
-      // Load data
-      data = (uint32_t)(*(request+0) <<  0) |
-             (uint32_t)(*(request+1) <<  8) |
-             (uint32_t)(*(request+2) << 16) |
-             (uint32_t)(*(request+3) << 24);
-      request += 4;
-      // Write DP/AP register
-      retry = DAP_Data.transfer.retry_count;
-      do {
-        response_value = SWD_Transfer(request_value, &data);
-      } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+    // Write register block, as far as it goes without waiting on each ACK
+    blind_count = request_count;
+    response_value = SWD_TransferBlind(request_value, request, &blind_count);
+    response_count += blind_count;
+    request_count  -= blind_count;
+    request        += 4U * blind_count;
+    if (response_value != DAP_TRANSFER_OK) {
+      goto end;
+    }
+    // Then the rest, or all of it, with up to SWD_QUEUE_DEPTH writes in flight
+    first = 0U;
+    for (submitted = completed = 0U; completed < request_count; completed++) {
+      for (; (submitted < request_count) && ((submitted - completed) < SWD_QUEUE_DEPTH); submitted++) {
+        // Load data
+        data = (uint32_t)(*(request+0) <<  0) |
+               (uint32_t)(*(request+1) <<  8) |
+               (uint32_t)(*(request+2) << 16) |
+               (uint32_t)(*(request+3) << 24);
+        request += 4;
+        // Write DP/AP register
+        slot = SWD_Submit(request_value, data);
+        if (submitted == 0U) {
+          first = slot;
+        }
+      }
+      response_value = SWD_Complete(first + completed, NULL);
       if (response_value != DAP_TRANSFER_OK) {
         goto end;
       }
       response_count++;
     }
     // Check last write
-    retry = DAP_Data.transfer.retry_count;
-    do {
-      response_value = SWD_Transfer(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
-    } while ((response_value == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort);
+    response_value = SWD_TransferRetry(DP_RDBUFF | DAP_TRANSFER_RnW, NULL);
   }
 
 end:
@@ -1760,6 +1812,7 @@ void DAP_Setup(void) {
 #if (DAP_SWD != 0)
   DAP_Data.swd_conf.turnaround  = 1U;
   DAP_Data.swd_conf.data_phase  = 0U;
+  SWD_Configure();
 #endif
 #if (DAP_JTAG != 0)
   DAP_Data.jtag_dev.count = 0U;
@@ -25,8 +25,12 @@
  *
  *---------------------------------------------------------------------------*/
  
+#include <string.h>
+
 #include "DAP_config.h"
 #include "DAP.h"
+#include "probe_vendor.h"
+#include "sw_dp_pio.h"
 
 //**************************************************************************************************
 /** 
@@ -51,22 +55,142 @@ uint32_t DAP_ProcessVendorCommand(const uint8_t *request, uint8_t *response) {
   *response++ = *request;        // copy Command ID
 
   switch (*request++) {          // first byte in request is Command ID
-    case ID_DAP_Vendor0:
-#if 0                            // example user command
-      num += 1U << 16;           // increment request count
-      if (*request == 1U) {      // when first command data byte is 1
-        *response++ = 'X';       // send 'X' as response
-        num++;                   // increment response count
+    case ID_DAP_Probe_WaitBackoff:
+      SWD_SetWaitBackoff((uint32_t)(*(request+0) <<  0) |
+                         (uint32_t)(*(request+1) <<  8));
+      num += 2U << 16;
+      *response++ = DAP_OK;
+      num++;
+      break;
+
+    case ID_DAP_Probe_WaitRetries: {
+      uint32_t last;
+      uint32_t total = SWD_GetWaitRetries(&last);
+      *response++ = DAP_OK;
+      *response++ = (uint8_t)(total >>  0);
+      *response++ = (uint8_t)(total >>  8);
+      *response++ = (uint8_t)(total >> 16);
+      *response++ = (uint8_t)(total >> 24);
+      *response++ = (uint8_t)(last  >>  0);
+      *response++ = (uint8_t)(last  >>  8);
+      *response++ = (uint8_t)(last  >> 16);
+      *response++ = (uint8_t)(last  >> 24);
+      num += 9U;
+      break;
+    }
+
+    case ID_DAP_Probe_ClockInfo: {
+      probe_clock_t clk;
+      uint32_t requested = SWJ_GetClock();
+      SWJ_GetClockPlan(&clk);
+      *response++ = DAP_OK;
+      *response++ = (uint8_t)(requested >>  0);
+      *response++ = (uint8_t)(requested >>  8);
+      *response++ = (uint8_t)(requested >> 16);
+      *response++ = (uint8_t)(requested >> 24);
+      *response++ = (uint8_t)(clk.freq_hz >>  0);
+      *response++ = (uint8_t)(clk.freq_hz >>  8);
+      *response++ = (uint8_t)(clk.freq_hz >> 16);
+      *response++ = (uint8_t)(clk.freq_hz >> 24);
+      *response++ = clk.cycles;
+      *response++ = (uint8_t)(clk.div_int >> 0);
+      *response++ = (uint8_t)(clk.div_int >> 8);
+      *response++ = clk.div_frac;
+      *response++ = clk.sample_delay;
+      num += 14U;
+      break;
+    }
+
+    case ID_DAP_Probe_SetOption: {
+      uint32_t value = (uint32_t)(*(request+1) <<  0) |
+                       (uint32_t)(*(request+2) <<  8) |
+                       (uint32_t)(*(request+3) << 16) |
+                       (uint32_t)(*(request+4) << 24);
+      num += 5U << 16;
+      switch (*request) {
+        case PROBE_OPT_SAMPLE_DELAY:
+          probe_set_sample_delay(value);
+          *response++ = DAP_OK;
+          break;
+        case PROBE_OPT_CALIBRATE:
+          SWD_SetCalibrateOnConnect((value != 0U) ? 1U : 0U);
+          *response++ = DAP_OK;
+          break;
+        case PROBE_OPT_BLIND_WRITES:
+          SWD_SetBlindWrites((value != 0U) ? 1U : 0U);
+          *response++ = DAP_OK;
+          break;
+        default:
+          *response++ = DAP_ERROR;
+          break;
       }
+      num++;
+      break;
+    }
+
+    case ID_DAP_Probe_Calibrate: {
+      const probe_calibration_t *cal = SWD_GetCalibration();
+      if (DAP_Data.debug_port != DAP_PORT_SWD) {
+        *response++ = DAP_ERROR;
+        num++;
+        break;
+      }
+      *response++ = SWD_Calibrate();
+      *response++ = (uint8_t)(cal->freq_hz >>  0);
+      *response++ = (uint8_t)(cal->freq_hz >>  8);
+      *response++ = (uint8_t)(cal->freq_hz >> 16);
+      *response++ = (uint8_t)(cal->freq_hz >> 24);
+      *response++ = cal->sample_delay;
+      num += 6U;
+      break;
+    }
+
+    case ID_DAP_Probe_PacketConfig: {
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V2)
+      uint8_t  count = *(request+0);
+      uint16_t size  = (uint16_t)(*(request+1) << 0) |
+                       (uint16_t)(*(request+2) << 8);
+      num += 3U << 16;
+      if ((count != 0U) && !dap_edpt_set_layout(count, size)) {
+        *response++ = DAP_ERROR;
+      } else {
+        *response++ = DAP_OK;
+      }
+      dap_edpt_get_layout(&count, &size);
+      *response++ = count;
+      *response++ = (uint8_t)(size >> 0);
+      *response++ = (uint8_t)(size >> 8);
+      num += 4U;
+#else
+      num += 3U << 16;
+      *response++ = DAP_ERROR;
+      num++;
 #endif
       break;
+    }
+
+    case ID_DAP_Probe_Stats: {
+      uint32_t stats[8] = {
+        dap_stats.usb_wakeups, dap_stats.dap_wakeups, dap_stats.commands,
+        dap_stats.latency_total_us, dap_stats.latency_max_us,
+        dap_stats.bytes_out, dap_stats.bytes_in, time_us_32() - dap_stats.start_us
+      };
+      num += 1U << 16;
+      if (*request != 0U) {
+        memset(&dap_stats, 0, sizeof(dap_stats));
+        dap_stats.start_us = time_us_32();
+      }
+      *response++ = DAP_OK;
+      for (uint32_t n = 0U; n < 8U; n++) {
+        *response++ = (uint8_t)(stats[n] >>  0);
+        *response++ = (uint8_t)(stats[n] >>  8);
+        *response++ = (uint8_t)(stats[n] >> 16);
+        *response++ = (uint8_t)(stats[n] >> 24);
+      }
+      num += 33U;
+      break;
+    }
 
-    case ID_DAP_Vendor1:  break;
-    case ID_DAP_Vendor2:  break;
-    case ID_DAP_Vendor3:  break;
-    case ID_DAP_Vendor4:  break;
-    case ID_DAP_Vendor5:  break;
-    case ID_DAP_Vendor6:  break;
     case ID_DAP_Vendor7:  break;
     case ID_DAP_Vendor8:  break;
     case ID_DAP_Vendor9:  break;
@@ -27,11 +27,8 @@
 
 #include "DAP_config.h"
 #include "DAP.h"
-#if (SWO_UART != 0)
-#include "Driver_USART.h"
-#endif
-#if (SWO_STREAM != 0)
-#include "cmsis_os2.h"
+#if ((SWO_UART != 0) || (SWO_STREAM != 0))
+#include "swo.h"
 #endif
 
 #if (SWO_STREAM != 0)
@@ -42,16 +39,7 @@
 
 #if (SWO_UART != 0)
 
-#ifndef  USART_PORT
-#define  USART_PORT 0           /* USART Port Number */
-#endif
-
-// USART Driver
-#define _USART_Driver_(n)  Driver_USART##n
-#define  USART_Driver_(n) _USART_Driver_(n)
-extern ARM_DRIVER_USART    USART_Driver_(USART_PORT);
-#define pUSART           (&USART_Driver_(USART_PORT))
-
+// SWO in UART mode is received by a PIO state machine, see swo.c
 static uint8_t USART_Ready = 0U;
 
 #endif  /* (SWO_UART != 0) */
@@ -103,7 +91,7 @@ static          uint32_t TransferSize;      /* Current Transfer Size */
 
 #if (SWO_UART != 0)
 
-// USART Driver Callback function
+// SWO UART receiver callback function
 //   event: event mask
 static void USART_Callback (uint32_t event) {
   uint32_t index_i;
@@ -111,7 +99,7 @@ static void USART_Callback (uint32_t event) {
   uint32_t count;
   uint32_t num;
 
-  if (event &  ARM_USART_EVENT_RECEIVE_COMPLETE) {
+  if (event &  SWO_EVENT_RECEIVE_COMPLETE) {
 #if (TIMESTAMP_CLOCK != 0U) 
     TraceTimestamp.tick = TIMESTAMP_GET();
 #endif
@@ -127,7 +115,7 @@ static void USART_Callback (uint32_t event) {
     if (count <= (SWO_BUFFER_SIZE - num)) {
       index_i &= SWO_BUFFER_SIZE - 1U;
       TraceBlockSize = num;
-      pUSART->Receive(&TraceBuf[index_i], num);
+      swo_uart_receive(&TraceBuf[index_i], num);
     } else {
       TraceStatus = DAP_SWO_CAPTURE_ACTIVE | DAP_SWO_CAPTURE_PAUSED;
     }
@@ -140,12 +128,10 @@ static void USART_Callback (uint32_t event) {
     }
 #endif
   }
-  if (event &  ARM_USART_EVENT_RX_OVERFLOW) {
+  if (event &  SWO_EVENT_RX_OVERFLOW) {
     SetTraceError(DAP_SWO_BUFFER_OVERRUN);
   }
-  if (event & (ARM_USART_EVENT_RX_BREAK         |
-               ARM_USART_EVENT_RX_FRAMING_ERROR |
-               ARM_USART_EVENT_RX_PARITY_ERROR)) {
+  if (event &  SWO_EVENT_RX_FRAMING_ERROR) {
     SetTraceError(DAP_SWO_STREAM_ERROR);
   }
 }
@@ -154,25 +140,17 @@ static void USART_Callback (uint32_t event) {
 //   enable: enable flag
 //   return: 1 - Success, 0 - Error
 __WEAK uint32_t UART_SWO_Mode (uint32_t enable) {
-  int32_t status;
 
   USART_Ready = 0U;
 
   if (enable != 0U) {
-    status = pUSART->Initialize(USART_Callback);
-    if (status != ARM_DRIVER_OK) {
-      return (0U);
-    }
-    status = pUSART->PowerControl(ARM_POWER_FULL);
-    if (status != ARM_DRIVER_OK) {
-      pUSART->Uninitialize();
+    if (!swo_uart_init(USART_Callback)) {
       return (0U);
     }
   } else {
-    pUSART->Control(ARM_USART_CONTROL_RX, 0U);
-    pUSART->Control(ARM_USART_ABORT_RECEIVE, 0U);
-    pUSART->PowerControl(ARM_POWER_OFF);
-    pUSART->Uninitialize();
+    swo_uart_rx_enable(false);
+    swo_uart_abort();
+    swo_uart_deinit();
   }
   return (1U);
 }
@@ -181,7 +159,6 @@ __WEAK uint32_t UART_SWO_Mode (uint32_t enable) {
 //   baudrate: requested baudrate
 //   return:   actual baudrate or 0 when not configured
 __WEAK uint32_t UART_SWO_Baudrate (uint32_t baudrate) {
-  int32_t  status;
   uint32_t index;
   uint32_t num;
 
@@ -190,20 +167,16 @@ __WEAK uint32_t UART_SWO_Baudrate (uint32_t baudrate) {
   }
 
   if (TraceStatus & DAP_SWO_CAPTURE_ACTIVE) {
-    pUSART->Control(ARM_USART_CONTROL_RX, 0U);
-    if (pUSART->GetStatus().rx_busy) {
-      TraceIndexI += pUSART->GetRxCount();
-      pUSART->Control(ARM_USART_ABORT_RECEIVE, 0U);
+    swo_uart_rx_enable(false);
+    if (swo_uart_rx_busy()) {
+      TraceIndexI += swo_uart_rx_count();
+      swo_uart_abort();
     }
   }
 
-  status = pUSART->Control(ARM_USART_MODE_ASYNCHRONOUS |
-                           ARM_USART_DATA_BITS_8       |
-                           ARM_USART_PARITY_NONE       |
-                           ARM_USART_STOP_BITS_1,
-                           baudrate);
+  baudrate = swo_uart_set_baud(baudrate);
 
-  if (status == ARM_DRIVER_OK) {
+  if (baudrate != 0U) {
     USART_Ready = 1U;
   } else {
     USART_Ready = 0U;
@@ -215,9 +188,9 @@ __WEAK uint32_t UART_SWO_Baudrate (uint32_t baudrate) {
       index = TraceIndexI & (SWO_BUFFER_SIZE - 1U);
       num = TRACE_BLOCK_SIZE - (index & (TRACE_BLOCK_SIZE - 1U));
       TraceBlockSize = num;
-      pUSART->Receive(&TraceBuf[index], num);
+      swo_uart_receive(&TraceBuf[index], num);
     }
-    pUSART->Control(ARM_USART_CONTROL_RX, 1U);
+    swo_uart_rx_enable(true);
   }
 
   return (baudrate);
@@ -227,26 +200,19 @@ __WEAK uint32_t UART_SWO_Baudrate (uint32_t baudrate) {
 //   active: active flag
 //   return: 1 - Success, 0 - Error
 __WEAK uint32_t UART_SWO_Control (uint32_t active) {
-  int32_t status;
 
   if (active) {
     if (!USART_Ready) { 
       return (0U);
     }
     TraceBlockSize = 1U;
-    status = pUSART->Receive(&TraceBuf[0], 1U);
-    if (status != ARM_DRIVER_OK) {
-      return (0U);
-    }
-    status = pUSART->Control(ARM_USART_CONTROL_RX, 1U);
-    if (status != ARM_DRIVER_OK) {
-      return (0U);
-    }
+    swo_uart_receive(&TraceBuf[0], 1U);
+    swo_uart_rx_enable(true);
   } else {
-    pUSART->Control(ARM_USART_CONTROL_RX, 0U);
-    if (pUSART->GetStatus().rx_busy) {
-      TraceIndexI += pUSART->GetRxCount();
-      pUSART->Control(ARM_USART_ABORT_RECEIVE, 0U);
+    swo_uart_rx_enable(false);
+    if (swo_uart_rx_busy()) {
+      TraceIndexI += swo_uart_rx_count();
+      swo_uart_abort();
     }
   }
   return (1U);
@@ -257,7 +223,7 @@ __WEAK uint32_t UART_SWO_Control (uint32_t active) {
 //   num: number of bytes to capture
 __WEAK void UART_SWO_Capture (uint8_t *buf, uint32_t num) {
   TraceBlockSize = num;
-  pUSART->Receive(buf, num);
+  swo_uart_receive(buf, num);
 }
 
 // Get UART SWO Pending Trace Count
@@ -265,8 +231,8 @@ __WEAK void UART_SWO_Capture (uint8_t *buf, uint32_t num) {
 __WEAK uint32_t UART_SWO_GetCount (void) {
   uint32_t count;
 
-  if (pUSART->GetStatus().rx_busy) {
-    count = pUSART->GetRxCount();
+  if (swo_uart_rx_busy()) {
+    count = swo_uart_rx_count();
   } else {
     count = 0U;
   }
@@ -706,8 +672,8 @@ uint32_t SWO_Data (const uint8_t *request, uint8_t *response) {
   if (TraceTransport == 1U) {
     n = (uint32_t)(*(request+0) << 0) |
         (uint32_t)(*(request+1) << 8);
-    if (n > (DAP_PACKET_SIZE - 4U)) {
-      n = DAP_PACKET_SIZE - 4U;
+    if (n > (DAP_PACKET_SIZE_ACTIVE - 4U)) {
+      n = DAP_PACKET_SIZE_ACTIVE - 4U;
     }
     if (count > n) {
       count = n;
@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef BOARD_HOST_OEN_H_
+#define BOARD_HOST_OEN_H_
+
+// The PROBE_IO_OEN pinout of board_example_config.h, for running
+// probe_oen.pio on the PIO model. No board in the tree uses it.
+
+#define PROBE_IO_OEN
+
+// PIO config
+#define PROBE_SM 0
+#define PROBE_PIN_OFFSET 12
+#define PROBE_PIN_SWDIOEN (PROBE_PIN_OFFSET + 0)
+#define PROBE_PIN_SWCLK (PROBE_PIN_OFFSET + 1)
+#define PROBE_PIN_SWDIO (PROBE_PIN_OFFSET + 2)
+#define PROBE_PIN_SWDI (PROBE_PIN_OFFSET + 3)
+// SWDI comes back through the level shifter
+#define PROBE_SAMPLE_DELAY 1
+
+// Target reset config
+#define PROBE_PIN_RESET 1
+
+#define PROBE_UART_TX 4
+#define PROBE_UART_RX 5
+
+#define PROBE_DAP_CONNECTED_LED 16
+#define PROBE_DAP_RUNNING_LED 17
+
+#define PROBE_PRODUCT_STRING "Debugprobe OEn model"
+
+#endif
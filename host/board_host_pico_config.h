@@ -0,0 +1,14 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef BOARD_HOST_PICO_H_
+#define BOARD_HOST_PICO_H_
+
+// Debugprobe on Pico for the PIO model, which has no SWO receiver
+#include "board_pico_config.h"
+#undef PROBE_SWO_PIN
+
+#endif
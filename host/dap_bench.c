@@ -0,0 +1,1088 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Runs a fixed set of DAP scenarios and writes the results as JSON, for
+ * comparing latency and throughput from one commit to the next:
+ *
+ *   swj_connect       line reset, JTAG-to-SWD, line reset and idle cycles
+ *                     as DAP_SWJ_Sequence requests, then the DPIDR read
+ *   transfer_latency  a DAP_Transfer of one DP read, and of one AP read
+ *   transfer_block    DAP_TransferBlock writes and reads of RAM at each
+ *                     SWCLK setting, in MB/s, read back and checked
+ *   queue_commands    DAP_Transfer requests sent one at a time, and the
+ *                     same requests batched with DAP_QueueCommands. A
+ *                     batch saves USB round trips, so only "usb" gives
+ *                     meaningful figures: in process both are the same
+ *                     time on the wire, and are marked "meaningful": false
+ *   uart              the USB-UART bridge echoing through a loopback
+ *
+ * -b picks the backend. "sim", the default, is the DAP core with the target
+ * from swd_sim.h on the bus, and times are the SWCLK cycles clocked at the
+ * SWCLK set: the cost on the wire, not of the host running the core. "usb"
+ * is a CMSIS-DAP v2 probe through the Linux usbfs (dap_usb.h), and times
+ * are wall-clock. dap_bench_pio has the "pio" backend in place of "sim":
+ * the real src/probe.c and PIO programs on the model in pio_sim.h, timed in
+ * its clk_sys cycles. Each request is left to run until the probe SM is
+ * idle, as in pio_replay.
+ *
+ * -o writes the report to a file in place of stdout and -L adds a label to
+ * it, such as the commit. -n sets the iterations of the connect, latency
+ * and queue scenarios (default 100) and -c the SWCLK they run at (default
+ * 4 MHz). -k sets the SWCLK settings of transfer_block as a comma-separated
+ * list (default 1, 2, 5, 10, 15 and 25 MHz), -s the bytes it moves each way
+ * (default 64 KB) and -m the address of the RAM it uses (default
+ * 0x20000000), which on real hardware must be RAM the target can spare. -q
+ * sets the requests in a batch (default 8, at most the probe's packet
+ * count). With usb, -S picks a probe by serial number and -u gives the tty
+ * of its UART bridge, with TX looped back to RX, for the uart scenario, -r
+ * its comma-separated baud rates (default 115200, 1000000 and 3000000).
+ * Without -u the uart scenario is reported as skipped.
+ *
+ * The target must be a single-drop ADIv5 SWD target; the DP is powered up
+ * and AP 0 used as a MEM-AP.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "dap_host.h"
+#include "probe_vendor.h"
+#include "swd_sim.h"
+#if DAP_BENCH_PIO
+#include "hardware/clocks.h"
+#include "pio_sim.h"
+#include "probe.h"
+#include "swd_bus.h"
+#endif
+#if DAP_BENCH_USB
+#include "dap_usb.h"
+#endif
+
+#define BENCH_SCHEMA		1
+#define MAX_LIST		16
+#define MAX_BATCH		32
+// DRW reads in each request of queue_commands
+#define QUEUE_TRANSFERS		4
+// Auto-increment wraps within 1 KB on every MEM-AP
+#define TAR_WRAP		1024u
+#define CSW_NO_INC		0x23000042u
+#define CSW_INC			0x23000052u
+#define CTRL_STAT_POWERUP	0x50000000u
+#define CTRL_STAT_POWERUP_ACK	0xa0000000u
+#define UART_TIMEOUT_MS		2000
+#if DAP_BENCH_PIO
+// A second of clk_sys, far beyond anything a queued stream takes
+#define PIO_IDLE_TIMEOUT	HOST_CLK_SYS_HZ
+#endif
+
+// MEM-AP registers as DAP_Transfer request bytes, beside DAP.h's DP ones
+#define AP_CSW			(DAP_TRANSFER_APnDP | 0x00u)
+#define AP_TAR			(DAP_TRANSFER_APnDP | 0x04u)
+#define AP_DRW			(DAP_TRANSFER_APnDP | 0x0cu)
+
+// Where requests go and the clock they are timed by
+struct backend {
+	const char *name;
+	const char *clock;
+	bool (*send)(const uint8_t *request, uint32_t len);
+	// Returns the response length, -1 if there is none
+	int (*receive)(uint8_t *response);
+	double (*now_us)(void);
+	void (*close)(void);
+	// Each request is a round trip to the probe, which batching saves
+	bool round_trips;
+};
+
+struct stats {
+	uint32_t n;
+	double min, median, mean, max;
+};
+
+struct json {
+	FILE *f;
+	int depth;
+	bool first;
+};
+
+static const struct backend *backend;
+static uint16_t packet_size;
+static uint8_t packet_count;
+static const char *error;
+static struct json json;
+
+static uint32_t block_data[256 * 1024 / 4];
+static uint32_t block_check[256 * 1024 / 4];
+static double samples[2][10000];
+
+static void put_u16(uint8_t *buf, uint16_t v)
+{
+	buf[0] = v & 0xff;
+	buf[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *buf, uint32_t v)
+{
+	buf[0] = v & 0xff;
+	buf[1] = (v >> 8) & 0xff;
+	buf[2] = (v >> 16) & 0xff;
+	buf[3] = v >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+// In-process backends: the DAP core, with responses queued as they are due
+
+static uint8_t pending[MAX_BATCH + 1][DAP_PACKET_SIZE];
+static uint32_t pending_len[MAX_BATCH + 1];
+static uint32_t pending_head, pending_count;
+
+static void local_emit(void *ctx, const uint8_t *response, uint32_t len)
+{
+	uint32_t n = (pending_head + pending_count) % (MAX_BATCH + 1);
+
+	(void)ctx;
+	if (pending_count == MAX_BATCH + 1)
+		return;
+	memcpy(pending[n], response, len);
+	pending_len[n] = len;
+	pending_count++;
+}
+
+static bool local_send(const uint8_t *request, uint32_t len)
+{
+	static uint8_t buf[DAP_PACKET_SIZE];
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, request, len);
+	dap_host_submit(buf, local_emit, NULL);
+#if DAP_BENCH_PIO
+	pio_sim_run_until_idle(0, PROBE_SM, PIO_IDLE_TIMEOUT);
+#endif
+	return true;
+}
+
+static int local_receive(uint8_t *response)
+{
+	uint32_t len;
+
+	if (!pending_count)
+		return -1;
+	len = pending_len[pending_head];
+	memcpy(response, pending[pending_head], len);
+	pending_head = (pending_head + 1) % (MAX_BATCH + 1);
+	pending_count--;
+	return len;
+}
+
+static swd_sim_t *sim;
+
+#if DAP_BENCH_PIO
+static struct swd_bus bus;
+
+static double local_now_us(void)
+{
+	return pio_sim_cycles() / (HOST_CLK_SYS_HZ / 1e6);
+}
+#else
+static uint64_t sim_cycles;
+static double sim_us;
+
+// SWCLK cycles so far, each at the SWCLK set when it was read. Times are
+// only taken with SWCLK steady, so a change is never charged at the wrong
+// rate inside one.
+static double local_now_us(void)
+{
+	uint64_t cycles = swd_sim_get_stats(sim)->cycles;
+	uint32_t hz = swd_sim_swclk(sim);
+
+	if (hz)
+		sim_us += (cycles - sim_cycles) * 1e6 / hz;
+	sim_cycles = cycles;
+	return sim_us;
+}
+#endif
+
+static void local_close(void)
+{
+	swd_sim_destroy(sim);
+}
+
+static const struct backend local_backend = {
+#if DAP_BENCH_PIO
+	.name = "pio",
+	.clock = "pio_sim clk_sys cycles",
+#else
+	.name = "sim",
+	.clock = "SWCLK cycles",
+#endif
+	.send = local_send,
+	.receive = local_receive,
+	.now_us = local_now_us,
+	.close = local_close,
+};
+
+static bool local_open(void)
+{
+	swd_sim_config_t config;
+
+	swd_sim_default_config(&config);
+	sim = swd_sim_create(&config);
+	if (!sim) {
+		fprintf(stderr, "out of memory\n");
+		return false;
+	}
+#if DAP_BENCH_PIO
+	swd_bus_init(&bus, sim);
+	pio_sim_attach(swd_bus_pins, &bus);
+#else
+	probe_set_backend(swd_sim_backend(sim));
+#endif
+	dap_host_init();
+	backend = &local_backend;
+	return true;
+}
+
+static double wall_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+#if DAP_BENCH_USB
+static dap_usb_t *usb;
+
+static bool usb_send(const uint8_t *request, uint32_t len)
+{
+	return dap_usb_write(usb, request, len) == (int)len;
+}
+
+static int usb_receive(uint8_t *response)
+{
+	return dap_usb_read(usb, response, DAP_PACKET_SIZE);
+}
+
+static void usb_close(void)
+{
+	dap_usb_close(usb);
+}
+
+static const struct backend usb_backend = {
+	.name = "usb",
+	.clock = "wall",
+	.send = usb_send,
+	.receive = usb_receive,
+	.now_us = wall_now_us,
+	.close = usb_close,
+	.round_trips = true,
+};
+
+static bool usb_open(const char *serial)
+{
+	usb = dap_usb_open(serial);
+	if (!usb) {
+		fprintf(stderr, "no CMSIS-DAP v2 probe found\n");
+		return false;
+	}
+	backend = &usb_backend;
+	return true;
+}
+#endif
+
+// A request and its response, which must be for the same command
+static int command(const uint8_t *request, uint32_t len, uint8_t *response)
+{
+	int n;
+
+	if (!backend->send(request, len)) {
+		error = "request not sent";
+		return -1;
+	}
+	n = backend->receive(response);
+	if (n < 1 || response[0] != request[0]) {
+		error = "no response";
+		return -1;
+	}
+	return n;
+}
+
+// A command whose response is its ID and a DAP_OK status
+static bool command_ok(const uint8_t *request, uint32_t len)
+{
+	uint8_t response[DAP_PACKET_SIZE];
+
+	if (command(request, len, response) < 2)
+		return false;
+	if (response[1] != DAP_OK) {
+		error = "command failed";
+		return false;
+	}
+	return true;
+}
+
+// A DAP_Transfer of count transfers, all of which must complete
+static bool transfer_ok(const uint8_t *request, uint32_t len, uint8_t *response)
+{
+	int n = command(request, len, response);
+
+	if (n < 3)
+		return false;
+	if (response[1] != request[2] || response[2] != DAP_TRANSFER_OK) {
+		error = "transfer failed";
+		return false;
+	}
+	return true;
+}
+
+static bool write_reg(uint8_t reg, uint32_t value)
+{
+	uint8_t request[8] = { ID_DAP_Transfer, 0, 1, reg };
+	uint8_t response[DAP_PACKET_SIZE];
+
+	put_u32(&request[4], value);
+	return transfer_ok(request, sizeof(request), response);
+}
+
+static bool read_reg(uint8_t reg, uint32_t *value)
+{
+	uint8_t request[4] = { ID_DAP_Transfer, 0, 1, reg | DAP_TRANSFER_RnW };
+	uint8_t response[DAP_PACKET_SIZE];
+
+	if (!transfer_ok(request, sizeof(request), response))
+		return false;
+	*value = get_u32(&response[3]);
+	return true;
+}
+
+static bool set_swclk(uint32_t hz)
+{
+	uint8_t request[5] = { ID_DAP_SWJ_Clock };
+
+	put_u32(&request[1], hz);
+	return command_ok(request, sizeof(request));
+}
+
+// The SWCLK the probe runs at, from its vendor command, 0 if it has none
+static uint32_t actual_swclk(void)
+{
+	uint8_t request[1] = { ID_DAP_Probe_ClockInfo };
+	uint8_t response[DAP_PACKET_SIZE];
+
+	if (command(request, sizeof(request), response) < 10 || response[1] != DAP_OK)
+		return 0;
+	return get_u32(&response[6]);
+}
+
+// A DAP_Info string, empty if there is none
+static void info_string(uint8_t id, char *buf, size_t size)
+{
+	uint8_t request[2] = { ID_DAP_Info, id };
+	uint8_t response[DAP_PACKET_SIZE];
+	int n = command(request, sizeof(request), response);
+	size_t len = n >= 2 ? response[1] : 0;
+
+	if (len > (size_t)n - 2)
+		len = 0;
+	if (len >= size)
+		len = size - 1;
+	memcpy(buf, &response[2], len);
+	buf[len] = '\0';
+}
+
+static uint32_t info_number(uint8_t id)
+{
+	uint8_t request[2] = { ID_DAP_Info, id };
+	uint8_t response[DAP_PACKET_SIZE];
+	int n = command(request, sizeof(request), response);
+
+	if (n < 3)
+		return 0;
+	if (response[1] == 1)
+		return response[2];
+	if (response[1] == 2 && n >= 4)
+		return response[2] | (response[3] << 8);
+	return 0;
+}
+
+static bool swj_connect(void)
+{
+	static const uint8_t line_reset[] = { ID_DAP_SWJ_Sequence, 51, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+	static const uint8_t jtag_to_swd[] = { ID_DAP_SWJ_Sequence, 16, 0x9e, 0xe7 };
+	static const uint8_t idle[] = { ID_DAP_SWJ_Sequence, 8, 0x00 };
+	uint32_t dpidr;
+
+	return command_ok(line_reset, sizeof(line_reset)) &&
+	       command_ok(jtag_to_swd, sizeof(jtag_to_swd)) &&
+	       command_ok(line_reset, sizeof(line_reset)) &&
+	       command_ok(idle, sizeof(idle)) &&
+	       read_reg(DP_IDCODE, &dpidr);
+}
+
+// Connects, powers up the debug domain and selects AP 0 bank 0
+static bool attach(uint32_t swclk)
+{
+	static const uint8_t connect[] = { ID_DAP_Connect, DAP_PORT_SWD };
+	static const uint8_t transfer_config[] = { ID_DAP_TransferConfigure, 0, 100, 0, 0, 0 };
+	static const uint8_t swd_config[] = { ID_DAP_SWD_Configure, 0 };
+	uint8_t response[DAP_PACKET_SIZE];
+	uint32_t ctrl_stat = 0;
+
+	if (command(connect, sizeof(connect), response) < 2 || response[1] != DAP_PORT_SWD) {
+		error = "DAP_Connect failed";
+		return false;
+	}
+	if (!set_swclk(swclk) || !command_ok(transfer_config, sizeof(transfer_config)) ||
+	    !command_ok(swd_config, sizeof(swd_config)) || !swj_connect() ||
+	    !write_reg(DP_CTRL_STAT, CTRL_STAT_POWERUP) || !write_reg(DP_SELECT, 0))
+		return false;
+	for (int i = 0; i < 100 && (ctrl_stat & CTRL_STAT_POWERUP_ACK) != CTRL_STAT_POWERUP_ACK; i++)
+		if (!read_reg(DP_CTRL_STAT, &ctrl_stat))
+			return false;
+	if ((ctrl_stat & CTRL_STAT_POWERUP_ACK) != CTRL_STAT_POWERUP_ACK) {
+		error = "debug power-up not acknowledged";
+		return false;
+	}
+	return true;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void get_stats(double *values, uint32_t n, struct stats *stats)
+{
+	double sum = 0.0;
+
+	qsort(values, n, sizeof(values[0]), cmp_double);
+	for (uint32_t i = 0; i < n; i++)
+		sum += values[i];
+	stats->n = n;
+	stats->min = values[0];
+	stats->max = values[n - 1];
+	stats->median = n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+	stats->mean = sum / n;
+}
+
+// A minimal JSON writer: members are placed with their commas and indent
+
+static void json_member(const char *key)
+{
+	if (!json.first)
+		fputc(',', json.f);
+	json.first = false;
+	if (json.depth)
+		fprintf(json.f, "\n%*s", 2 * json.depth, "");
+	if (key)
+		fprintf(json.f, "\"%s\": ", key);
+}
+
+static void json_open(const char *key, char bracket)
+{
+	json_member(key);
+	fputc(bracket, json.f);
+	json.depth++;
+	json.first = true;
+}
+
+static void json_close(char bracket)
+{
+	json.depth--;
+	if (!json.first)
+		fprintf(json.f, "\n%*s", 2 * json.depth, "");
+	fputc(bracket, json.f);
+	json.first = false;
+}
+
+static void json_string(const char *key, const char *value)
+{
+	json_member(key);
+	fputc('"', json.f);
+	for (; *value; value++) {
+		if (*value == '"' || *value == '\\')
+			fprintf(json.f, "\\%c", *value);
+		else if ((unsigned char)*value < 0x20)
+			fprintf(json.f, "\\u%04x", *value);
+		else
+			fputc(*value, json.f);
+	}
+	fputc('"', json.f);
+}
+
+static void json_uint(const char *key, unsigned long value)
+{
+	json_member(key);
+	fprintf(json.f, "%lu", value);
+}
+
+static void json_double(const char *key, double value)
+{
+	json_member(key);
+	if (isfinite(value))
+		fprintf(json.f, "%.3f", value);
+	else
+		fputs("null", json.f);
+}
+
+static void json_bool(const char *key, bool value)
+{
+	json_member(key);
+	fputs(value ? "true" : "false", json.f);
+}
+
+static void json_stats(const char *key, const struct stats *stats)
+{
+	json_open(key, '{');
+	json_uint("n", stats->n);
+	json_double("min_us", stats->min);
+	json_double("median_us", stats->median);
+	json_double("mean_us", stats->mean);
+	json_double("max_us", stats->max);
+	json_close('}');
+}
+
+// Ends a scenario's object with the error that stopped it, if any
+static bool json_result(bool ok)
+{
+	if (!ok)
+		json_string("error", error ? error : "failed");
+	error = NULL;
+	return ok;
+}
+
+static bool bench_connect(uint32_t iterations)
+{
+	struct stats stats;
+	bool ok = true;
+
+	json_open("swj_connect", '{');
+	for (uint32_t i = 0; ok && i < iterations; i++) {
+		double start = backend->now_us();
+
+		ok = swj_connect();
+		samples[0][i] = backend->now_us() - start;
+	}
+	if (ok) {
+		get_stats(samples[0], iterations, &stats);
+		json_stats("time", &stats);
+	}
+	ok = json_result(ok);
+	json_close('}');
+	return ok;
+}
+
+static bool bench_latency(uint32_t iterations, uint32_t address)
+{
+	struct stats stats;
+	uint32_t value;
+	bool ok;
+
+	json_open("transfer_latency", '{');
+	ok = write_reg(AP_CSW, CSW_NO_INC) && write_reg(AP_TAR, address);
+	for (uint32_t i = 0; ok && i < iterations; i++) {
+		double start = backend->now_us();
+
+		ok = read_reg(DP_IDCODE, &value);
+		samples[0][i] = backend->now_us() - start;
+		start = backend->now_us();
+		ok = ok && read_reg(AP_DRW, &value);
+		samples[1][i] = backend->now_us() - start;
+	}
+	if (ok) {
+		get_stats(samples[0], iterations, &stats);
+		json_stats("dp_read", &stats);
+		get_stats(samples[1], iterations, &stats);
+		json_stats("ap_read", &stats);
+	}
+	ok = json_result(ok);
+	json_close('}');
+	return ok;
+}
+
+// One direction of a block transfer, in DAP_TransferBlock requests of as
+// many words as fit, none crossing a TAR auto-increment boundary
+static bool block_transfer(uint32_t address, uint32_t *words, uint32_t count, bool read)
+{
+	uint8_t request[DAP_PACKET_SIZE];
+	uint8_t response[DAP_PACKET_SIZE];
+	uint32_t max_words = (packet_size - (read ? 4 : 5)) / 4;
+	uint32_t n = 0;
+
+	while (n < count) {
+		uint32_t addr = address + 4 * n;
+		uint32_t chunk = (TAR_WRAP - (addr % TAR_WRAP)) / 4;
+
+		if (chunk > count - n)
+			chunk = count - n;
+		if (!write_reg(AP_TAR, addr))
+			return false;
+		while (chunk) {
+			uint32_t words_now = chunk < max_words ? chunk : max_words;
+			uint32_t len = 5;
+			int resp_len;
+
+			request[0] = ID_DAP_TransferBlock;
+			request[1] = 0;
+			put_u16(&request[2], words_now);
+			request[4] = AP_DRW | (read ? DAP_TRANSFER_RnW : 0);
+			if (!read) {
+				for (uint32_t i = 0; i < words_now; i++)
+					put_u32(&request[len + 4 * i], words[n + i]);
+				len += 4 * words_now;
+			}
+			resp_len = command(request, len, response);
+			if (resp_len < 4)
+				return false;
+			if ((response[1] | (response[2] << 8)) != words_now || response[3] != DAP_TRANSFER_OK ||
+			    (read && (uint32_t)resp_len < 4 + 4 * words_now)) {
+				error = "block transfer failed";
+				return false;
+			}
+			if (read)
+				for (uint32_t i = 0; i < words_now; i++)
+					words[n + i] = get_u32(&response[4 + 4 * i]);
+			n += words_now;
+			chunk -= words_now;
+		}
+	}
+	return true;
+}
+
+// A failed setting leaves the target to be attached again for the next
+static void bench_block(const uint32_t *clocks, int clock_count, uint32_t bytes, uint32_t address,
+			uint32_t swclk)
+{
+	uint32_t count = bytes / 4;
+
+	json_open("transfer_block", '[');
+	for (int c = 0; c < clock_count; c++) {
+		double start, write_us, read_us;
+		bool ok;
+
+		json_open(NULL, '{');
+		json_uint("swclk_hz", clocks[c]);
+		for (uint32_t i = 0; i < count; i++)
+			block_data[i] = (i * 0x9e3779b9u) ^ clocks[c];
+		ok = set_swclk(clocks[c]);
+		if (ok) {
+			uint32_t actual = actual_swclk();
+
+			if (actual)
+				json_uint("actual_hz", actual);
+		}
+		ok = ok && write_reg(AP_CSW, CSW_INC);
+
+		start = backend->now_us();
+		ok = ok && block_transfer(address, block_data, count, false);
+		write_us = backend->now_us() - start;
+		start = backend->now_us();
+		ok = ok && block_transfer(address, block_check, count, true);
+		read_us = backend->now_us() - start;
+
+		if (ok) {
+			json_uint("bytes", 4 * count);
+			json_double("write_us", write_us);
+			json_double("read_us", read_us);
+			json_double("write_mb_per_s", 4 * count / write_us);
+			json_double("read_mb_per_s", 4 * count / read_us);
+			json_bool("verified", !memcmp(block_data, block_check, 4 * count));
+		}
+		if (!json_result(ok))
+			attach(swclk);
+		json_close('}');
+	}
+	json_close(']');
+}
+
+// Sends batch DAP_Transfer requests and takes their responses, one at a
+// time or all queued but the last, which closes the batch
+static bool queue_batch(uint32_t batch, bool queued)
+{
+	uint8_t request[DAP_PACKET_SIZE];
+	uint8_t response[DAP_PACKET_SIZE];
+	uint8_t *transfer = queued ? &request[2] : request;
+	uint32_t len = 3 + QUEUE_TRANSFERS;
+
+	if (queued) {
+		request[0] = ID_DAP_QueueCommands;
+		request[1] = 1;
+	}
+	transfer[0] = ID_DAP_Transfer;
+	transfer[1] = 0;
+	transfer[2] = QUEUE_TRANSFERS;
+	memset(&transfer[3], AP_DRW | DAP_TRANSFER_RnW, QUEUE_TRANSFERS);
+
+	if (!queued) {
+		for (uint32_t i = 0; i < batch; i++)
+			if (!transfer_ok(request, len, response))
+				return false;
+		return true;
+	}
+	for (uint32_t i = 0; i + 1 < batch; i++)
+		if (!backend->send(request, len + 2)) {
+			error = "request not sent";
+			return false;
+		}
+	if (!backend->send(transfer, len)) {
+		error = "request not sent";
+		return false;
+	}
+	for (uint32_t i = 0; i < batch; i++) {
+		bool last = i + 1 == batch;
+		int n = backend->receive(response);
+
+		// A queued request is answered as DAP_ExecuteCommands
+		if (n < (last ? 3 : 5) || (last ? response[0] != ID_DAP_Transfer :
+			      response[0] != ID_DAP_ExecuteCommands || response[2] != ID_DAP_Transfer)) {
+			error = "no response";
+			return false;
+		}
+		if ((last ? response[2] : response[4]) != DAP_TRANSFER_OK) {
+			error = "transfer failed";
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool bench_queue(uint32_t iterations, uint32_t batch, uint32_t address)
+{
+	struct stats stats;
+	bool ok;
+
+	json_open("queue_commands", '{');
+	if (batch > packet_count)
+		batch = packet_count;
+	json_uint("requests", batch);
+	json_uint("transfers_per_request", QUEUE_TRANSFERS);
+	ok = batch && write_reg(AP_CSW, CSW_NO_INC) && write_reg(AP_TAR, address);
+	for (uint32_t i = 0; ok && i < iterations; i++) {
+		double start = backend->now_us();
+
+		ok = queue_batch(batch, false);
+		samples[0][i] = backend->now_us() - start;
+		start = backend->now_us();
+		ok = ok && queue_batch(batch, true);
+		samples[1][i] = backend->now_us() - start;
+	}
+	if (ok) {
+		get_stats(samples[0], iterations, &stats);
+		json_stats("unbatched", &stats);
+		get_stats(samples[1], iterations, &stats);
+		json_stats("batched", &stats);
+		json_bool("meaningful", backend->round_trips);
+		if (!backend->round_trips)
+			json_string("note", "no USB round trip to save in process, the times are of the wire alone");
+	}
+	ok = json_result(ok);
+	json_close('}');
+	return ok;
+}
+
+static speed_t baud_speed(uint32_t baud)
+{
+	static const struct {
+		uint32_t baud;
+		speed_t speed;
+	} speeds[] = {
+		{ 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+		{ 115200, B115200 }, { 230400, B230400 }, { 460800, B460800 }, { 921600, B921600 },
+		{ 1000000, B1000000 }, { 2000000, B2000000 }, { 3000000, B3000000 }, { 4000000, B4000000 },
+	};
+
+	for (size_t i = 0; i < count_of(speeds); i++)
+		if (speeds[i].baud == baud)
+			return speeds[i].speed;
+	return B0;
+}
+
+// Writes a quarter of a second of data and reads it back, timing the lot
+static void uart_loopback(const char *tty, uint32_t baud)
+{
+	static uint8_t tx[256 * 1024], rx[256 * 1024];
+	uint32_t bytes = baud / 40;
+	uint32_t sent = 0, received = 0, errors = 0;
+	struct termios tio;
+	speed_t speed = baud_speed(baud);
+	double start, seconds;
+	int fd;
+
+	json_open(NULL, '{');
+	json_uint("baud", baud);
+	if (bytes < 1024)
+		bytes = 1024;
+	if (bytes > sizeof(tx))
+		bytes = sizeof(tx);
+	if (speed == B0) {
+		json_string("error", "unsupported baud rate");
+		json_close('}');
+		return;
+	}
+	fd = open(tty, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0 || tcgetattr(fd, &tio)) {
+		json_string("error", strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		json_close('}');
+		return;
+	}
+	cfmakeraw(&tio);
+	cfsetspeed(&tio, speed);
+	tcsetattr(fd, TCSANOW, &tio);
+	tcflush(fd, TCIOFLUSH);
+	for (uint32_t i = 0; i < bytes; i++)
+		tx[i] = i * 7 + (i >> 8);
+
+	start = wall_now_us();
+	while (received < bytes) {
+		struct pollfd pfd = {
+			.fd = fd,
+			.events = POLLIN | (sent < bytes ? POLLOUT : 0),
+		};
+		ssize_t n;
+
+		if (poll(&pfd, 1, UART_TIMEOUT_MS) <= 0)
+			break;
+		if ((pfd.revents & POLLOUT) && sent < bytes) {
+			n = write(fd, &tx[sent], bytes - sent);
+			if (n > 0)
+				sent += n;
+		}
+		if (pfd.revents & POLLIN) {
+			n = read(fd, &rx[received], bytes - received);
+			if (n > 0)
+				received += n;
+		}
+	}
+	seconds = (wall_now_us() - start) / 1e6;
+	close(fd);
+
+	for (uint32_t i = 0; i < received; i++)
+		if (rx[i] != tx[i])
+			errors++;
+	json_uint("bytes", bytes);
+	json_uint("received", received);
+	json_uint("errors", errors);
+	json_double("bytes_per_s", received / seconds);
+	// Against the 10 bit times of an 8N1 frame
+	json_double("efficiency", received / seconds / (baud / 10.0));
+	json_close('}');
+}
+
+static void bench_uart(const char *tty, const uint32_t *bauds, int baud_count)
+{
+	json_open("uart", '{');
+	if (!tty) {
+		json_string("skipped", backend == &local_backend ? "no UART on this backend" : "no loopback tty given");
+		json_close('}');
+		return;
+	}
+	json_string("tty", tty);
+	json_open("rates", '[');
+	for (int i = 0; i < baud_count; i++)
+		uart_loopback(tty, bauds[i]);
+	json_close(']');
+	json_close('}');
+}
+
+static int parse_list(const char *arg, uint32_t *list)
+{
+	int n = 0;
+	char *end;
+
+	while (n < MAX_LIST) {
+		list[n] = strtoul(arg, &end, 0);
+		if (end == arg || !list[n])
+			return -1;
+		n++;
+		if (!*end)
+			return n;
+		if (*end != ',')
+			return -1;
+		arg = end + 1;
+	}
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t clocks[MAX_LIST] = { 1000000, 2000000, 5000000, 10000000, 15000000, 25000000 };
+	uint32_t bauds[MAX_LIST] = { 115200, 1000000, 3000000 };
+	int clock_count = 6;
+	int baud_count = 3;
+	const char *backend_name = local_backend.name;
+	const char *out = NULL;
+	const char *label = NULL;
+	const char *serial = NULL;
+	const char *tty = NULL;
+	uint32_t iterations = 100;
+	uint32_t swclk = 4000000;
+	uint32_t bytes = 64 * 1024;
+	uint32_t address = 0x20000000;
+	uint32_t batch = 8;
+	char info[DAP_PACKET_SIZE];
+	bool ok;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:o:L:n:c:k:s:m:q:S:u:r:")) != -1) {
+		switch (opt) {
+		case 'b':
+			backend_name = optarg;
+			break;
+		case 'o':
+			out = optarg;
+			break;
+		case 'L':
+			label = optarg;
+			break;
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			swclk = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			clock_count = parse_list(optarg, clocks);
+			if (clock_count < 0)
+				goto usage;
+			break;
+		case 's':
+			bytes = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			address = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			batch = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			serial = optarg;
+			break;
+		case 'u':
+			tty = optarg;
+			break;
+		case 'r':
+			baud_count = parse_list(optarg, bauds);
+			if (baud_count < 0)
+				goto usage;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc || !iterations || iterations > count_of(samples[0]) || !swclk ||
+	    bytes < 4 || bytes > sizeof(block_data) || (address & 3) || !batch || batch > MAX_BATCH)
+		goto usage;
+
+	if (!strcmp(backend_name, local_backend.name)) {
+		if (tty) {
+			fprintf(stderr, "-u needs a probe on USB\n");
+			return 2;
+		}
+		ok = local_open();
+#if DAP_BENCH_USB
+	} else if (!strcmp(backend_name, "usb")) {
+		ok = usb_open(serial);
+#endif
+	} else {
+		fprintf(stderr, "unknown backend %s\n", backend_name);
+		return 2;
+	}
+	if (!ok)
+		return 1;
+	(void)serial;
+
+	json.f = out ? fopen(out, "w") : stdout;
+	if (!json.f) {
+		perror(out);
+		return 1;
+	}
+	json.first = true;
+
+	packet_size = info_number(DAP_ID_PACKET_SIZE);
+	packet_count = info_number(DAP_ID_PACKET_COUNT);
+	if (packet_size > DAP_PACKET_SIZE)
+		packet_size = DAP_PACKET_SIZE;
+	if (packet_size < 64 || !packet_count) {
+		fprintf(stderr, "no packet size from DAP_Info: %s\n", error ? error : "bad response");
+		return 1;
+	}
+
+	json_open(NULL, '{');
+	json_uint("schema", BENCH_SCHEMA);
+	if (label)
+		json_string("label", label);
+	json_string("backend", backend->name);
+	json_string("clock", backend->clock);
+	json_open("probe", '{');
+	info_string(DAP_ID_VENDOR, info, sizeof(info));
+	json_string("vendor", info);
+	info_string(DAP_ID_PRODUCT, info, sizeof(info));
+	json_string("product", info);
+	info_string(DAP_ID_SER_NUM, info, sizeof(info));
+	json_string("serial", info);
+	info_string(DAP_ID_FW_VER, info, sizeof(info));
+	json_string("protocol", info);
+	json_uint("packet_size", packet_size);
+	json_uint("packet_count", packet_count);
+	json_close('}');
+	json_open("config", '{');
+	json_uint("iterations", iterations);
+	json_uint("swclk_hz", swclk);
+	json_uint("block_bytes", bytes & ~3u);
+	json_uint("block_address", address);
+	json_uint("batch", batch);
+	json_close('}');
+
+	// Each scenario starts from an attached target, even if the one
+	// before it failed
+	ok = attach(swclk);
+	if (ok) {
+		if (!bench_connect(iterations))
+			attach(swclk);
+		if (!bench_latency(iterations, address))
+			attach(swclk);
+		if (!bench_queue(iterations, batch, address))
+			attach(swclk);
+		bench_block(clocks, clock_count, bytes, address, swclk);
+	} else {
+		fprintf(stderr, "cannot attach to the target: %s\n", error);
+		json_string("error", error);
+		error = NULL;
+	}
+	bench_uart(tty, bauds, baud_count);
+	json_close('}');
+	fputc('\n', json.f);
+
+	if (out)
+		fclose(json.f);
+	backend->close();
+	return ok ? 0 : 1;
+
+usage:
+	fprintf(stderr, "usage: %s [-b backend] [-o report] [-L label] [-n iterations] [-c swclk] [-k swclk,...] [-s bytes] [-m address] [-q batch] [-S serial] [-u tty] [-r baud,...]\n",
+		argv[0]);
+	return 2;
+}
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "dap_host.h"
+#include "dap_queue.h"
+
+// What tusb_edpt_handler.c and main.c provide in the firmware
+
+dap_stats_t dap_stats;
+
+static uint8_t response_buf[DAP_PACKET_SIZE];
+
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V2)
+// There is no USB reset to wait for, so a new layout applies at once
+static uint8_t dap_packet_count = PROBE_DAP_PACKET_COUNT;
+static uint16_t dap_packet_size = DAP_PACKET_SIZE;
+
+uint16_t dap_edpt_packet_size(void)
+{
+	return dap_packet_size;
+}
+
+uint8_t dap_edpt_packet_count(void)
+{
+	return dap_packet_count;
+}
+
+bool dap_edpt_set_layout(uint8_t count, uint16_t size)
+{
+	if (count < 3 || count > DAP_PACKET_COUNT ||
+	    size < 64 || size > DAP_PACKET_SIZE || (size % 64) != 0 ||
+	    2u * count * size > PROBE_DAP_RING_SIZE)
+		return false;
+	dap_packet_count = count;
+	dap_packet_size = size;
+	return true;
+}
+
+void dap_edpt_get_layout(uint8_t *count, uint16_t *size)
+{
+	*count = dap_packet_count;
+	*size = dap_packet_size;
+}
+#endif
+
+void dap_host_init(void)
+{
+	DAP_Setup();
+	dap_stats.start_us = time_us_32();
+}
+
+uint32_t dap_host_execute(const uint8_t *request, uint8_t *response)
+{
+	uint32_t start = time_us_32();
+	uint32_t resp_len = DAP_ExecuteCommand(request, response) & 0xffff;
+	uint32_t latency = time_us_32() - start;
+
+	dap_stats.commands++;
+	dap_stats.latency_total_us += latency;
+	if (latency > dap_stats.latency_max_us)
+		dap_stats.latency_max_us = latency;
+	return resp_len;
+}
+
+void dap_host_reset(void)
+{
+	dap_queue_drop();
+}
+
+void dap_host_submit(const uint8_t *request, dap_host_emit_fn emit, void *ctx)
+{
+	uint8_t req[DAP_PACKET_SIZE];
+	uint32_t resp_len;
+
+	if (*request == ID_DAP_TransferAbort) {
+		DAP_TransferAbort = 1U;
+		return;
+	}
+
+	if (*request == ID_DAP_QueueCommands) {
+		memcpy(req, request, DAP_PACKET_SIZE);
+		dap_stats.commands++;
+		dap_queue_hold(req, DAP_PACKET_SIZE_ACTIVE, emit, ctx);
+		return;
+	}
+
+	dap_queue_release(emit, ctx);
+	resp_len = dap_host_execute(request, response_buf);
+	emit(ctx, response_buf, resp_len);
+}
@@ -0,0 +1,28 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef DAP_HOST_H
+#define DAP_HOST_H
+
+#include <stdint.h>
+
+// The DAP command processor as dap_thread runs it, without USB. Responses
+// are at most DAP_PACKET_SIZE bytes.
+void dap_host_init(void);
+// Returns the response length
+uint32_t dap_host_execute(const uint8_t *request, uint8_t *response);
+
+// A request, in a DAP_PACKET_SIZE buffer, as the firmware takes it off the
+// endpoint. DAP_TransferAbort raises the abort flag and has no response.
+// DAP_QueueCommands runs at once but its response is held until a request
+// of any other kind closes the batch. emit is called for every response
+// that is due, oldest first.
+typedef void (*dap_host_emit_fn)(void *ctx, const uint8_t *response, uint32_t len);
+void dap_host_submit(const uint8_t *request, dap_host_emit_fn emit, void *ctx);
+// Drop a batch still held, as a USB reset does, when the host goes away
+void dap_host_reset(void);
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Runs DAP requests through the host build of the command processor, for
+ * profiling it under perf or cachegrind. Each line of stdin is one request
+ * in hex (whitespace, and anything after a #, ignored); the response goes to
+ * stdout the same way.
+ * -n N repeats the whole input N times, printing only the last pass.
+ *
+ * -s puts the simulated target from swd_sim.h on the bus, otherwise it is
+ * empty. -l sets its memory latency in SWCLK cycles, -w N,M answers M WAITs
+ * after every Nth AP access, -f N and -p N give a bus error on every Nth
+ * memory access and bad parity on every Nth read. The simulator's counters
+ * go to stderr at the end.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "DAP_config.h"
+#include "dap_host.h"
+#include "swd_sim.h"
+
+#define MAX_REQUESTS 4096
+
+static uint8_t requests[MAX_REQUESTS][DAP_PACKET_SIZE];
+static uint8_t response[DAP_PACKET_SIZE];
+
+static int parse_hex(const char *line, uint8_t *buf)
+{
+	int len = 0;
+	int nibbles = 0;
+
+	for (; *line && *line != '#'; line++) {
+		if (isspace((unsigned char)*line))
+			continue;
+		if (!isxdigit((unsigned char)*line) || len == DAP_PACKET_SIZE)
+			return -1;
+		int v = isdigit((unsigned char)*line) ? *line - '0' : (tolower((unsigned char)*line) - 'a' + 10);
+		buf[len] = (buf[len] << 4) | v;
+		if (++nibbles % 2 == 0)
+			len++;
+	}
+	return nibbles % 2 ? -1 : len;
+}
+
+int main(int argc, char **argv)
+{
+	char line[4 * DAP_PACKET_SIZE];
+	unsigned long passes = 1;
+	int count = 0;
+	int opt;
+	bool use_sim = false;
+	swd_sim_config_t config;
+	swd_sim_t *sim = NULL;
+
+	swd_sim_default_config(&config);
+	while ((opt = getopt(argc, argv, "n:sl:w:f:p:")) != -1) {
+		switch (opt) {
+		case 'n':
+			passes = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			use_sim = true;
+			break;
+		case 'l':
+			config.mem_latency = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			if (sscanf(optarg, "%u,%u", &config.wait_every, &config.wait_burst) != 2)
+				goto usage;
+			break;
+		case 'f':
+			config.fault_every = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			config.parity_error_every = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	while (fgets(line, sizeof(line), stdin)) {
+		if (count == MAX_REQUESTS) {
+			fprintf(stderr, "more than %d requests\n", MAX_REQUESTS);
+			return 1;
+		}
+		memset(requests[count], 0, DAP_PACKET_SIZE);
+		int len = parse_hex(line, requests[count]);
+		if (len < 0) {
+			fprintf(stderr, "bad request: %s", line);
+			return 1;
+		}
+		if (len)
+			count++;
+	}
+
+	if (use_sim) {
+		sim = swd_sim_create(&config);
+		if (!sim) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+		probe_set_backend(swd_sim_backend(sim));
+	}
+
+	dap_host_init();
+	for (unsigned long pass = 1; pass <= passes; pass++) {
+		for (int i = 0; i < count; i++) {
+			uint32_t resp_len = dap_host_execute(requests[i], response);
+			if (pass < passes)
+				continue;
+			for (uint32_t n = 0; n < resp_len; n++)
+				printf("%02x", response[n]);
+			printf("\n");
+		}
+	}
+
+	if (sim) {
+		const swd_sim_stats_t *stats = swd_sim_get_stats(sim);
+
+		fprintf(stderr, "cycles %llu requests %u ok %u wait %u fault %u no_response %u\n",
+			(unsigned long long)stats->cycles, stats->requests, stats->acks_ok,
+			stats->acks_wait, stats->acks_fault, stats->no_response);
+		fprintf(stderr, "protocol_errors %u line_resets %u wdata_errors %u contention %u undriven %u\n",
+			stats->protocol_errors, stats->line_resets, stats->wdata_errors,
+			stats->contention, stats->undriven);
+		fprintf(stderr, "ap_reads %u ap_writes %u bus_errors %u\n",
+			stats->ap_reads, stats->ap_writes, stats->bus_errors);
+		swd_sim_destroy(sim);
+	}
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-n passes] [-s [-l latency] [-w every,burst] [-f every] [-p every]] < requests\n",
+		argv[0]);
+	return 2;
+}
@@ -0,0 +1,266 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Serves the host build of the DAP command processor, with the simulated
+ * target from swd_sim.h on the bus, as a CMSIS-DAP v2 probe over TCP. The
+ * framing is that of OpenOCD's cmsis-dap tcp backend: every packet follows
+ * an 8 byte header of a little-endian u32 signature "DAP\0", u16 payload
+ * length, a type byte (1 request, 2 response) and a reserved byte. One
+ * client is served at a time, and target state and RAM carry over from one
+ * to the next, as they would on a probe left plugged in.
+ *
+ * Requests go through dap_host_submit(), so DAP_QueueCommands batches and
+ * DAP_TransferAbort behave as over USB. A batch left open by a client that
+ * disconnects is dropped, as on a USB reset.
+ *
+ * -a and -P set the address and port to listen on (default 127.0.0.1:4441).
+ * -i loads a file into the target's RAM at start, and -o writes the RAM to
+ * a file as each client disconnects, for checking what was loaded. -l, -w,
+ * -f and -p are as for dap_replay. A summary of each session goes to
+ * stderr.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "dap_host.h"
+#include "swd_sim.h"
+
+#define DAP_TCP_PORT		4441
+#define DAP_TCP_SIGNATURE	0x00504144u
+#define DAP_TCP_REQUEST		0x01
+#define DAP_TCP_RESPONSE	0x02
+#define DAP_TCP_HEADER_SIZE	8
+
+static uint8_t request[DAP_PACKET_SIZE];
+
+static bool read_full(int fd, uint8_t *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = recv(fd, buf, len, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+static bool write_full(int fd, const uint8_t *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+struct session {
+	int fd;
+	bool failed;
+};
+
+static void send_response(void *ctx, const uint8_t *response, uint32_t len)
+{
+	struct session *session = ctx;
+	uint8_t packet[DAP_TCP_HEADER_SIZE + DAP_PACKET_SIZE];
+
+	if (session->failed)
+		return;
+	packet[0] = DAP_TCP_SIGNATURE & 0xff;
+	packet[1] = (DAP_TCP_SIGNATURE >> 8) & 0xff;
+	packet[2] = (DAP_TCP_SIGNATURE >> 16) & 0xff;
+	packet[3] = DAP_TCP_SIGNATURE >> 24;
+	packet[4] = len & 0xff;
+	packet[5] = len >> 8;
+	packet[6] = DAP_TCP_RESPONSE;
+	packet[7] = 0;
+	memcpy(&packet[DAP_TCP_HEADER_SIZE], response, len);
+	dap_stats.bytes_in += len;
+	if (!write_full(session->fd, packet, DAP_TCP_HEADER_SIZE + len))
+		session->failed = true;
+}
+
+static void serve(int fd)
+{
+	struct session session = {
+		.fd = fd,
+	};
+	uint8_t header[DAP_TCP_HEADER_SIZE];
+
+	while (!session.failed && read_full(fd, header, sizeof(header))) {
+		uint32_t signature = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+		uint16_t len = header[4] | (header[5] << 8);
+
+		if (signature != DAP_TCP_SIGNATURE || header[6] != DAP_TCP_REQUEST || !len ||
+		    len > dap_edpt_packet_size()) {
+			fprintf(stderr, "bad packet header, closing\n");
+			return;
+		}
+		memset(request, 0, sizeof(request));
+		if (!read_full(fd, request, len))
+			return;
+		dap_stats.bytes_out += len;
+		dap_host_submit(request, send_response, &session);
+	}
+}
+
+static int load_image(const char *path, uint8_t *mem, uint32_t size)
+{
+	FILE *f = fopen(path, "rb");
+	size_t n;
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	n = fread(mem, 1, size, f);
+	fclose(f);
+	fprintf(stderr, "loaded %zu bytes from %s\n", n, path);
+	return 0;
+}
+
+static void dump_image(const char *path, const uint8_t *mem, uint32_t size)
+{
+	FILE *f = fopen(path, "wb");
+
+	if (!f || fwrite(mem, 1, size, f) != size)
+		perror(path);
+	if (f)
+		fclose(f);
+}
+
+static void print_stats(swd_sim_t *sim)
+{
+	const swd_sim_stats_t *stats = swd_sim_get_stats(sim);
+
+	fprintf(stderr, "commands %u bytes out %u in %u latency avg %u max %u us\n",
+		dap_stats.commands, dap_stats.bytes_out, dap_stats.bytes_in,
+		dap_stats.commands ? dap_stats.latency_total_us / dap_stats.commands : 0,
+		dap_stats.latency_max_us);
+	fprintf(stderr, "cycles %llu requests %u ok %u wait %u fault %u no_response %u\n",
+		(unsigned long long)stats->cycles, stats->requests, stats->acks_ok,
+		stats->acks_wait, stats->acks_fault, stats->no_response);
+	fprintf(stderr, "ap_reads %u ap_writes %u bus_errors %u protocol_errors %u\n",
+		stats->ap_reads, stats->ap_writes, stats->bus_errors, stats->protocol_errors);
+}
+
+int main(int argc, char **argv)
+{
+	const char *address = "127.0.0.1";
+	const char *image_in = NULL;
+	const char *image_out = NULL;
+	unsigned long port = DAP_TCP_PORT;
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+	};
+	swd_sim_config_t config;
+	swd_sim_t *sim;
+	int opt;
+	int one = 1;
+	int server;
+
+	swd_sim_default_config(&config);
+	while ((opt = getopt(argc, argv, "a:P:i:o:l:w:f:p:")) != -1) {
+		switch (opt) {
+		case 'a':
+			address = optarg;
+			break;
+		case 'P':
+			port = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			image_in = optarg;
+			break;
+		case 'o':
+			image_out = optarg;
+			break;
+		case 'l':
+			config.mem_latency = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			if (sscanf(optarg, "%u,%u", &config.wait_every, &config.wait_burst) != 2)
+				goto usage;
+			break;
+		case 'f':
+			config.fault_every = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			config.parity_error_every = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc || !port || port > 65535 || inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+		goto usage;
+	addr.sin_port = htons(port);
+
+	sim = swd_sim_create(&config);
+	if (!sim) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	if (image_in && load_image(image_in, swd_sim_memory(sim), config.mem_size))
+		return 1;
+	probe_set_backend(swd_sim_backend(sim));
+	dap_host_init();
+
+	server = socket(AF_INET, SOCK_STREAM, 0);
+	if (server < 0 ||
+	    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+	    bind(server, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(server, 1)) {
+		perror("listen");
+		return 1;
+	}
+	fprintf(stderr, "CMSIS-DAP on %s:%lu\n", address, port);
+
+	for (;;) {
+		int fd = accept(server, NULL, NULL);
+
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			return 1;
+		}
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		memset(&dap_stats, 0, sizeof(dap_stats));
+		dap_stats.start_us = time_us_32();
+		swd_sim_clear_stats(sim);
+
+		serve(fd);
+		close(fd);
+		dap_host_reset();
+
+		print_stats(sim);
+		if (image_out)
+			dump_image(image_out, swd_sim_memory(sim), config.mem_size);
+	}
+
+usage:
+	fprintf(stderr, "usage: %s [-a address] [-P port] [-i image] [-o image] [-l latency] [-w every,burst] [-f every] [-p every]\n",
+		argv[0]);
+	return 2;
+}
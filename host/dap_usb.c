@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/usbdevice_fs.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "dap_usb.h"
+
+#define USB_SYSFS		"/sys/bus/usb/devices"
+#define DAP_USB_TIMEOUT_MS	1000
+
+struct dap_usb {
+	int fd;
+	unsigned int interface;
+	uint8_t ep_out;
+	uint8_t ep_in;
+	char serial[128];
+};
+
+// The first line of a sysfs attribute, empty if it is missing
+static void read_attr(const char *dir, const char *name, char *buf, size_t size)
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	buf[0] = '\0';
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	if (!fgets(buf, size, f))
+		buf[0] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+	fclose(f);
+}
+
+// The lowest-numbered bulk endpoints of an interface
+static bool find_endpoints(const char *dir, uint8_t *ep_out, uint8_t *ep_in)
+{
+	DIR *d = opendir(dir);
+	struct dirent *ent;
+	char path[PATH_MAX];
+	char attr[32];
+
+	if (!d)
+		return false;
+	*ep_out = 0;
+	*ep_in = 0;
+	while ((ent = readdir(d))) {
+		unsigned long addr;
+
+		if (strncmp(ent->d_name, "ep_", 3) ||
+		    snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name) >= (int)sizeof(path))
+			continue;
+		read_attr(path, "type", attr, sizeof(attr));
+		if (strcmp(attr, "Bulk"))
+			continue;
+		addr = strtoul(ent->d_name + 3, NULL, 16);
+		if (addr & 0x80) {
+			if (!*ep_in || addr < *ep_in)
+				*ep_in = addr;
+		} else if (!*ep_out || addr < *ep_out) {
+			*ep_out = addr;
+		}
+	}
+	closedir(d);
+	return *ep_out && *ep_in;
+}
+
+dap_usb_t *dap_usb_open(const char *serial)
+{
+	DIR *d = opendir(USB_SYSFS);
+	struct dirent *ent;
+	dap_usb_t *usb = NULL;
+
+	if (!d) {
+		perror(USB_SYSFS);
+		return NULL;
+	}
+	while (!usb && (ent = readdir(d))) {
+		char itf_dir[PATH_MAX];
+		char dev_dir[PATH_MAX];
+		char attr[128];
+		char node[64];
+		uint8_t ep_out, ep_in;
+		const char *colon = strchr(ent->d_name, ':');
+
+		if (!colon)
+			continue;
+		snprintf(itf_dir, sizeof(itf_dir), USB_SYSFS "/%s", ent->d_name);
+		snprintf(dev_dir, sizeof(dev_dir), USB_SYSFS "/%.*s", (int)(colon - ent->d_name), ent->d_name);
+		read_attr(itf_dir, "bInterfaceClass", attr, sizeof(attr));
+		if (strcmp(attr, "ff"))
+			continue;
+		read_attr(itf_dir, "interface", attr, sizeof(attr));
+		if (!strstr(attr, "CMSIS-DAP") || !find_endpoints(itf_dir, &ep_out, &ep_in))
+			continue;
+
+		usb = calloc(1, sizeof(*usb));
+		if (!usb)
+			break;
+		read_attr(dev_dir, "serial", usb->serial, sizeof(usb->serial));
+		if (serial && strcmp(serial, usb->serial)) {
+			free(usb);
+			usb = NULL;
+			continue;
+		}
+		read_attr(itf_dir, "bInterfaceNumber", attr, sizeof(attr));
+		usb->interface = strtoul(attr, NULL, 16);
+		usb->ep_out = ep_out;
+		usb->ep_in = ep_in;
+
+		read_attr(dev_dir, "busnum", attr, sizeof(attr));
+		snprintf(node, sizeof(node), "/dev/bus/usb/%03lu", strtoul(attr, NULL, 10));
+		read_attr(dev_dir, "devnum", attr, sizeof(attr));
+		snprintf(node + strlen(node), sizeof(node) - strlen(node), "/%03lu", strtoul(attr, NULL, 10));
+		usb->fd = open(node, O_RDWR);
+		if (usb->fd < 0 || ioctl(usb->fd, USBDEVFS_CLAIMINTERFACE, &usb->interface)) {
+			perror(node);
+			if (usb->fd >= 0)
+				close(usb->fd);
+			free(usb);
+			usb = NULL;
+			break;
+		}
+	}
+	closedir(d);
+	return usb;
+}
+
+void dap_usb_close(dap_usb_t *usb)
+{
+	ioctl(usb->fd, USBDEVFS_RELEASEINTERFACE, &usb->interface);
+	close(usb->fd);
+	free(usb);
+}
+
+static int bulk(dap_usb_t *usb, uint8_t ep, void *data, uint32_t len)
+{
+	struct usbdevfs_bulktransfer xfer = {
+		.ep = ep,
+		.len = len,
+		.timeout = DAP_USB_TIMEOUT_MS,
+		.data = data,
+	};
+
+	return ioctl(usb->fd, USBDEVFS_BULK, &xfer);
+}
+
+int dap_usb_write(dap_usb_t *usb, const uint8_t *request, uint32_t len)
+{
+	return bulk(usb, usb->ep_out, (void *)request, len);
+}
+
+int dap_usb_read(dap_usb_t *usb, uint8_t *response, uint32_t size)
+{
+	return bulk(usb, usb->ep_in, response, size);
+}
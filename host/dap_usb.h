@@ -0,0 +1,24 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef DAP_USB_H
+#define DAP_USB_H
+
+#include <stdint.h>
+
+// A CMSIS-DAP v2 probe on USB, through the Linux usbfs: the first vendor
+// class interface named "CMSIS-DAP", with its lowest-numbered bulk OUT and
+// IN endpoints. Needs read-write access to the device node.
+typedef struct dap_usb dap_usb_t;
+
+// The first probe found, or the one with the given serial number if not NULL
+dap_usb_t *dap_usb_open(const char *serial);
+void dap_usb_close(dap_usb_t *usb);
+// Return the bytes moved, -1 on error or timeout
+int dap_usb_write(dap_usb_t *usb, const uint8_t *request, uint32_t len);
+int dap_usb_read(dap_usb_t *usb, uint8_t *response, uint32_t size);
+
+#endif
@@ -0,0 +1,13 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+/* The DAP core makes no RTOS calls. probe_config.h only wants these for its
+ * debug printing, which is compiled out. */
+
+#endif
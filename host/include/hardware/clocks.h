@@ -0,0 +1,25 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_HARDWARE_CLOCKS_H
+#define HOST_HARDWARE_CLOCKS_H
+
+#include "pico/stdlib.h"
+
+// SWCLK is planned against the RP2040's default clk_sys
+#define HOST_CLK_SYS_HZ 125000000u
+
+enum clock_index {
+    clk_sys = 5,
+};
+
+static inline uint32_t clock_get_hz(enum clock_index clk_index)
+{
+    (void)clk_index;
+    return HOST_CLK_SYS_HZ;
+}
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_HARDWARE_DMA_H
+#define HOST_HARDWARE_DMA_H
+
+/* The pico-sdk DMA API over the model in pio_sim.c. Channels move one
+ * transfer per clk_sys cycle, paced by their DREQ; chaining and IRQs are
+ * not modelled. Addresses are host pointers. */
+
+#include "pico/stdlib.h"
+
+#define NUM_DMA_CHANNELS                12
+
+#define DMA_CH0_CTRL_TRIG_EN_LSB        0
+#define DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB 2
+#define DMA_CH0_CTRL_TRIG_INCR_READ_LSB 4
+#define DMA_CH0_CTRL_TRIG_INCR_WRITE_LSB 5
+#define DMA_CH0_CTRL_TRIG_RING_SIZE_LSB 6
+#define DMA_CH0_CTRL_TRIG_RING_SEL_LSB  10
+#define DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB  11
+#define DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB  15
+#define DMA_CH0_CTRL_TRIG_BUSY_LSB      24
+
+#define DREQ_PIO0_TX0                   0
+#define DREQ_PIO0_RX0                   4
+#define DREQ_PIO1_TX0                   8
+#define DREQ_PIO1_RX0                   12
+#define DREQ_FORCE                      0x3f
+
+typedef struct {
+    volatile uintptr_t read_addr;
+    volatile uintptr_t write_addr;
+    volatile uint32_t transfer_count;
+    volatile uint32_t ctrl_trig;
+} dma_channel_hw_t;
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2,
+};
+
+typedef struct {
+    uint32_t ctrl;
+} dma_channel_config;
+
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+    c->ctrl = (c->ctrl & ~(1u << DMA_CH0_CTRL_TRIG_INCR_READ_LSB)) | ((uint)incr << DMA_CH0_CTRL_TRIG_INCR_READ_LSB);
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+    c->ctrl = (c->ctrl & ~(1u << DMA_CH0_CTRL_TRIG_INCR_WRITE_LSB)) | ((uint)incr << DMA_CH0_CTRL_TRIG_INCR_WRITE_LSB);
+}
+
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+    c->ctrl = (c->ctrl & ~(0x3fu << DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB)) | (dreq << DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB);
+}
+
+static inline void channel_config_set_chain_to(dma_channel_config *c, uint chain_to)
+{
+    c->ctrl = (c->ctrl & ~(0xfu << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB)) | (chain_to << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB);
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size)
+{
+    c->ctrl = (c->ctrl & ~(0x3u << DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB)) | ((uint)size << DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB);
+}
+
+static inline void channel_config_set_ring(dma_channel_config *c, bool write, uint size_bits)
+{
+    c->ctrl = (c->ctrl & ~((0xfu << DMA_CH0_CTRL_TRIG_RING_SIZE_LSB) | (1u << DMA_CH0_CTRL_TRIG_RING_SEL_LSB))) |
+              (size_bits << DMA_CH0_CTRL_TRIG_RING_SIZE_LSB) | ((uint)write << DMA_CH0_CTRL_TRIG_RING_SEL_LSB);
+}
+
+static inline void channel_config_set_enable(dma_channel_config *c, bool enable)
+{
+    c->ctrl = (c->ctrl & ~(1u << DMA_CH0_CTRL_TRIG_EN_LSB)) | ((uint)enable << DMA_CH0_CTRL_TRIG_EN_LSB);
+}
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    dma_channel_config c = { 0 };
+
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, DREQ_FORCE);
+    channel_config_set_chain_to(&c, channel);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_ring(&c, false, 0);
+    channel_config_set_enable(&c, true);
+    return c;
+}
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_claim(uint channel);
+void dma_channel_unclaim(uint channel);
+
+// Lets the model run on, as every access to the DMA from the CPU does
+dma_channel_hw_t *dma_channel_hw_addr(uint channel);
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_start(uint channel);
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count);
+void dma_channel_transfer_to_buffer_now(uint channel, volatile void *write_addr, uint32_t transfer_count);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+
+#endif
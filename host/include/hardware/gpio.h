@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_HARDWARE_GPIO_H
+#define HOST_HARDWARE_GPIO_H
+
+#include "pico/stdlib.h"
+
+#define GPIO_IN  false
+#define GPIO_OUT true
+
+enum gpio_function {
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+    GPIO_FUNC_NULL = 0x1f,
+};
+
+// Pad state behind the gpio_* calls, one bit per GPIO. Without the PIO model
+// nothing drives the pads from outside, so in follows the SIO outputs and
+// the pulls; the model sets in every cycle.
+struct host_gpio {
+    uint32_t sio_out;
+    uint32_t sio_oe;
+    uint32_t func_sio;
+    uint32_t func_pio0;
+    uint32_t func_pio1;
+    uint32_t pull_up;
+    uint32_t pull_down;
+    uint32_t in;
+};
+
+extern struct host_gpio host_gpio;
+
+void gpio_init(uint gpio);
+void gpio_deinit(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_pull_up(uint gpio);
+void gpio_pull_down(uint gpio);
+void gpio_disable_pulls(uint gpio);
+
+#endif
@@ -0,0 +1,241 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_HARDWARE_PIO_H
+#define HOST_HARDWARE_PIO_H
+
+/* The pico-sdk PIO API over the cycle model in pio_sim.c. Register layouts
+ * and bit positions are the RP2040's; only the registers the firmware
+ * touches directly are kept up to date. */
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+
+#define NUM_PIOS                        2
+#define NUM_PIO_STATE_MACHINES          4
+#define PIO_INSTRUCTION_COUNT           32
+
+#define PIO_FDEBUG_RXSTALL_LSB          0
+#define PIO_FDEBUG_RXUNDER_LSB          8
+#define PIO_FDEBUG_TXOVER_LSB           16
+#define PIO_FDEBUG_TXSTALL_LSB          24
+
+#define PIO_SM0_CLKDIV_INT_LSB          16
+#define PIO_SM0_CLKDIV_FRAC_LSB         8
+#define PIO_SM0_EXECCTRL_SIDE_EN_LSB    30
+#define PIO_SM0_EXECCTRL_SIDE_PINDIR_LSB 29
+#define PIO_SM0_EXECCTRL_JMP_PIN_LSB    24
+#define PIO_SM0_EXECCTRL_WRAP_TOP_LSB   12
+#define PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB 7
+#define PIO_SM0_EXECCTRL_STATUS_SEL_LSB 4
+#define PIO_SM0_EXECCTRL_STATUS_N_LSB   0
+#define PIO_SM0_SHIFTCTRL_FJOIN_RX_LSB  31
+#define PIO_SM0_SHIFTCTRL_FJOIN_TX_LSB  30
+#define PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB 25
+#define PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB 20
+#define PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_LSB 19
+#define PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_LSB 18
+#define PIO_SM0_SHIFTCTRL_AUTOPULL_LSB  17
+#define PIO_SM0_SHIFTCTRL_AUTOPUSH_LSB  16
+#define PIO_SM0_PINCTRL_SIDESET_COUNT_LSB 29
+#define PIO_SM0_PINCTRL_SET_COUNT_LSB   26
+#define PIO_SM0_PINCTRL_OUT_COUNT_LSB   20
+#define PIO_SM0_PINCTRL_IN_BASE_LSB     15
+#define PIO_SM0_PINCTRL_SIDESET_BASE_LSB 10
+#define PIO_SM0_PINCTRL_SET_BASE_LSB    5
+#define PIO_SM0_PINCTRL_OUT_BASE_LSB    0
+
+typedef struct {
+    volatile uint32_t clkdiv;
+    volatile uint32_t execctrl;
+    volatile uint32_t shiftctrl;
+    volatile uint32_t addr;
+    volatile uint32_t instr;
+    volatile uint32_t pinctrl;
+} pio_sm_hw_t;
+
+typedef struct {
+    volatile uint32_t ctrl;
+    volatile uint32_t fstat;
+    volatile uint32_t fdebug;
+    volatile uint32_t flevel;
+    volatile uint32_t txf[NUM_PIO_STATE_MACHINES];
+    volatile uint32_t rxf[NUM_PIO_STATE_MACHINES];
+    volatile uint32_t irq;
+    volatile uint32_t irq_force;
+    volatile uint32_t input_sync_bypass;
+    volatile uint32_t instr_mem[PIO_INSTRUCTION_COUNT];
+    pio_sm_hw_t sm[NUM_PIO_STATE_MACHINES];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+
+// Every access to a PIO block from the CPU lets the model run on
+PIO pio_host_instance(uint index);
+#define pio0 pio_host_instance(0)
+#define pio1 pio_host_instance(1)
+
+typedef struct {
+    uint32_t clkdiv;
+    uint32_t execctrl;
+    uint32_t shiftctrl;
+    uint32_t pinctrl;
+} pio_sm_config;
+
+typedef struct pio_program {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin;
+    uint8_t pio_version;
+} pio_program_t;
+
+enum pio_fifo_join {
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2,
+};
+
+enum pio_instr_bits {
+    pio_instr_bits_jmp = 0x0000,
+    pio_instr_bits_wait = 0x2000,
+    pio_instr_bits_in = 0x4000,
+    pio_instr_bits_out = 0x6000,
+    pio_instr_bits_push = 0x8000,
+    pio_instr_bits_pull = 0x8080,
+    pio_instr_bits_mov = 0xa000,
+    pio_instr_bits_irq = 0xc000,
+    pio_instr_bits_set = 0xe000,
+};
+
+static inline uint _pio_major_instr_bits(uint instr)
+{
+    return instr & 0xe000u;
+}
+
+static inline uint pio_encode_jmp(uint addr)
+{
+    return pio_instr_bits_jmp | addr;
+}
+
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count)
+{
+    c->pinctrl = (c->pinctrl & ~((0x1fu << PIO_SM0_PINCTRL_OUT_BASE_LSB) | (0x3fu << PIO_SM0_PINCTRL_OUT_COUNT_LSB))) |
+                 (out_base << PIO_SM0_PINCTRL_OUT_BASE_LSB) | (out_count << PIO_SM0_PINCTRL_OUT_COUNT_LSB);
+}
+
+static inline void sm_config_set_set_pins(pio_sm_config *c, uint set_base, uint set_count)
+{
+    c->pinctrl = (c->pinctrl & ~((0x1fu << PIO_SM0_PINCTRL_SET_BASE_LSB) | (0x7u << PIO_SM0_PINCTRL_SET_COUNT_LSB))) |
+                 (set_base << PIO_SM0_PINCTRL_SET_BASE_LSB) | (set_count << PIO_SM0_PINCTRL_SET_COUNT_LSB);
+}
+
+static inline void sm_config_set_in_pins(pio_sm_config *c, uint in_base)
+{
+    c->pinctrl = (c->pinctrl & ~(0x1fu << PIO_SM0_PINCTRL_IN_BASE_LSB)) | (in_base << PIO_SM0_PINCTRL_IN_BASE_LSB);
+}
+
+static inline void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base)
+{
+    c->pinctrl = (c->pinctrl & ~(0x1fu << PIO_SM0_PINCTRL_SIDESET_BASE_LSB)) |
+                 (sideset_base << PIO_SM0_PINCTRL_SIDESET_BASE_LSB);
+}
+
+static inline void sm_config_set_sideset(pio_sm_config *c, uint bit_count, bool optional, bool pindirs)
+{
+    c->pinctrl = (c->pinctrl & ~(0x7u << PIO_SM0_PINCTRL_SIDESET_COUNT_LSB)) |
+                 (bit_count << PIO_SM0_PINCTRL_SIDESET_COUNT_LSB);
+    c->execctrl = (c->execctrl & ~((1u << PIO_SM0_EXECCTRL_SIDE_EN_LSB) | (1u << PIO_SM0_EXECCTRL_SIDE_PINDIR_LSB))) |
+                  ((uint)optional << PIO_SM0_EXECCTRL_SIDE_EN_LSB) | ((uint)pindirs << PIO_SM0_EXECCTRL_SIDE_PINDIR_LSB);
+}
+
+static inline void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t div_int, uint8_t div_frac)
+{
+    c->clkdiv = ((uint32_t)div_int << PIO_SM0_CLKDIV_INT_LSB) | ((uint32_t)div_frac << PIO_SM0_CLKDIV_FRAC_LSB);
+}
+
+static inline void sm_config_set_clkdiv(pio_sm_config *c, float div)
+{
+    uint16_t div_int = (uint16_t)div;
+    uint8_t div_frac = div_int ? (uint8_t)((div - (float)div_int) * 256.0f) : 0;
+
+    sm_config_set_clkdiv_int_frac(c, div_int, div_frac);
+}
+
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap)
+{
+    c->execctrl = (c->execctrl & ~((0x1fu << PIO_SM0_EXECCTRL_WRAP_TOP_LSB) | (0x1fu << PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB))) |
+                  (wrap_target << PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB) | (wrap << PIO_SM0_EXECCTRL_WRAP_TOP_LSB);
+}
+
+static inline void sm_config_set_jmp_pin(pio_sm_config *c, uint pin)
+{
+    c->execctrl = (c->execctrl & ~(0x1fu << PIO_SM0_EXECCTRL_JMP_PIN_LSB)) | (pin << PIO_SM0_EXECCTRL_JMP_PIN_LSB);
+}
+
+static inline void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint push_threshold)
+{
+    c->shiftctrl = (c->shiftctrl & ~((1u << PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_LSB) | (1u << PIO_SM0_SHIFTCTRL_AUTOPUSH_LSB) |
+                                     (0x1fu << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB))) |
+                   ((uint)shift_right << PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_LSB) |
+                   ((uint)autopush << PIO_SM0_SHIFTCTRL_AUTOPUSH_LSB) |
+                   ((push_threshold & 0x1fu) << PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB);
+}
+
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold)
+{
+    c->shiftctrl = (c->shiftctrl & ~((1u << PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_LSB) | (1u << PIO_SM0_SHIFTCTRL_AUTOPULL_LSB) |
+                                     (0x1fu << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB))) |
+                   ((uint)shift_right << PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_LSB) |
+                   ((uint)autopull << PIO_SM0_SHIFTCTRL_AUTOPULL_LSB) |
+                   ((pull_threshold & 0x1fu) << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB);
+}
+
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join)
+{
+    c->shiftctrl = (c->shiftctrl & ~((1u << PIO_SM0_SHIFTCTRL_FJOIN_TX_LSB) | (1u << PIO_SM0_SHIFTCTRL_FJOIN_RX_LSB))) |
+                   ((uint)(join == PIO_FIFO_JOIN_TX) << PIO_SM0_SHIFTCTRL_FJOIN_TX_LSB) |
+                   ((uint)(join == PIO_FIFO_JOIN_RX) << PIO_SM0_SHIFTCTRL_FJOIN_RX_LSB);
+}
+
+static inline pio_sm_config pio_get_default_sm_config(void)
+{
+    pio_sm_config c = { 0 };
+
+    sm_config_set_clkdiv_int_frac(&c, 1, 0);
+    sm_config_set_wrap(&c, 0, 31);
+    sm_config_set_in_shift(&c, true, false, 32);
+    sm_config_set_out_shift(&c, true, false, 32);
+    return c;
+}
+
+uint pio_get_index(PIO pio);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+void pio_gpio_init(PIO pio, uint pin);
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+uint pio_add_program(PIO pio, const pio_program_t *program);
+void pio_remove_program(PIO pio, const pio_program_t *program, uint loaded_offset);
+
+void pio_sm_claim(PIO pio, uint sm);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_unclaim(PIO pio, uint sm);
+
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac);
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+uint8_t pio_sm_get_pc(PIO pio, uint sm);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+int pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+uint32_t pio_sm_get(PIO pio, uint sm);
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+
+#endif
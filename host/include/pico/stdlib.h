@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+/* The few pico-sdk definitions the DAP core uses, for the host build */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef unsigned int uint;
+
+#ifndef __unused
+#define __unused __attribute__((unused))
+#endif
+#define __isr
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#ifndef MIN
+#define MIN(a, b) ((b) > (a) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+// pico/util debug pins, unused on the host
+#define CU_REGISTER_DEBUG_PINS(...)
+#define CU_SELECT_DEBUG_PINS(...)
+#define DEBUG_PINS_SET(p, v) ((void)0)
+#define DEBUG_PINS_CLR(p, v) ((void)0)
+
+static inline void tight_loop_contents(void)
+{
+}
+
+// Microseconds since the host build started, or simulated time in the PIO
+// model
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+void busy_wait_us_32(uint32_t delay_us);
+
+static inline void __dmb(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void __compiler_memory_barrier(void)
+{
+    __asm__ volatile ("" : : : "memory");
+}
+
+#endif
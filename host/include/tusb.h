@@ -0,0 +1,12 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_TUSB_H
+#define HOST_TUSB_H
+
+/* probe.c includes this but makes no TinyUSB calls */
+
+#endif
@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <time.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#if HOST_SIM_TIME
+#include "pio_sim.h"
+#endif
+
+// Pads come out of reset with their pull-downs on
+struct host_gpio host_gpio = {
+    .pull_down = 0x3fffffffu,
+};
+
+#if HOST_SIM_TIME
+// Time passes only as the PIO model runs
+
+uint64_t time_us_64(void)
+{
+    return pio_sim_cycles() / (HOST_CLK_SYS_HZ / 1000000);
+}
+
+void busy_wait_us_32(uint32_t delay_us)
+{
+    pio_sim_run((uint64_t)delay_us * (HOST_CLK_SYS_HZ / 1000000));
+}
+#else
+uint64_t time_us_64(void)
+{
+    static uint64_t start;
+    struct timespec ts;
+    uint64_t now;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000u;
+    if (!start)
+        start = now;
+    return now - start;
+}
+
+void busy_wait_us_32(uint32_t delay_us)
+{
+    uint64_t end = time_us_64() + delay_us;
+
+    while (time_us_64() < end)
+        ;
+}
+#endif
+
+uint32_t time_us_32(void)
+{
+    return (uint32_t)time_us_64();
+}
+
+// Level on the pads driven by SIO or left to the pulls. The PIO model
+// resolves every pad, PIO outputs and outside drive included, each cycle.
+static void gpio_update(void)
+{
+    uint32_t sio = host_gpio.sio_oe & host_gpio.func_sio;
+    uint32_t floating = ~sio & ~(host_gpio.func_pio0 | host_gpio.func_pio1);
+    uint32_t pulled = host_gpio.pull_up | (host_gpio.in & ~host_gpio.pull_down);
+
+    host_gpio.in = (host_gpio.sio_out & sio) | (pulled & floating) | (host_gpio.in & ~sio & ~floating);
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+    uint32_t mask = 1u << gpio;
+
+    host_gpio.func_sio &= ~mask;
+    host_gpio.func_pio0 &= ~mask;
+    host_gpio.func_pio1 &= ~mask;
+    if (fn == GPIO_FUNC_SIO)
+        host_gpio.func_sio |= mask;
+    else if (fn == GPIO_FUNC_PIO0)
+        host_gpio.func_pio0 |= mask;
+    else if (fn == GPIO_FUNC_PIO1)
+        host_gpio.func_pio1 |= mask;
+    gpio_update();
+}
+
+void gpio_init(uint gpio)
+{
+    host_gpio.sio_oe &= ~(1u << gpio);
+    host_gpio.sio_out &= ~(1u << gpio);
+    gpio_set_function(gpio, GPIO_FUNC_SIO);
+}
+
+void gpio_deinit(uint gpio)
+{
+    gpio_set_function(gpio, GPIO_FUNC_NULL);
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+    host_gpio.sio_oe = (host_gpio.sio_oe & ~(1u << gpio)) | ((uint32_t)out << gpio);
+    gpio_update();
+}
+
+void gpio_put(uint gpio, bool value)
+{
+    host_gpio.sio_out = (host_gpio.sio_out & ~(1u << gpio)) | ((uint32_t)value << gpio);
+    gpio_update();
+}
+
+bool gpio_get(uint gpio)
+{
+    return (host_gpio.in >> gpio) & 1u;
+}
+
+void gpio_pull_up(uint gpio)
+{
+    host_gpio.pull_up |= 1u << gpio;
+    host_gpio.pull_down &= ~(1u << gpio);
+    gpio_update();
+}
+
+void gpio_pull_down(uint gpio)
+{
+    host_gpio.pull_down |= 1u << gpio;
+    host_gpio.pull_up &= ~(1u << gpio);
+    gpio_update();
+}
+
+void gpio_disable_pulls(uint gpio)
+{
+    host_gpio.pull_up &= ~(1u << gpio);
+    host_gpio.pull_down &= ~(1u << gpio);
+}
@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Runs the pioasm output of src/autobaud.pio on the PIO model in pio_sim.h,
+ * set up as autobaud_init() does - pio1, the RX FIFO drained into a 4 KB
+ * ring by DMA - with an 8N1 UART stream on PROBE_UART_RX. For each baud
+ * rate on the command line (default 9600, 115200, 1000000 and 3000000) it
+ * sends frames of text, then estimates the rate from the low pulse lengths
+ * the way estimate_baud_rate() does: the shortest length seen in at least
+ * 5% of the samples is one bit, and the lengths within 10% of it are
+ * averaged. One line per rate goes to stdout with the estimate, its error,
+ * the samples taken and the pushes the state machine dropped.
+ *
+ * -f sets the number of frames sent at each rate (default 32).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "pio_sim.h"
+#include "probe_config.h"
+#include "autobaud.pio.h"
+
+#define BUF_SIZE 1024
+#define MIN_FREQUENCY 0.05f
+
+// A UART transmitter on the RX pin, idle while baud is 0
+struct uart_line {
+	uint32_t baud;
+	uint64_t start;
+	uint frames;
+};
+
+static const char text[] = "Hello from the target, 0123456789\r\n";
+
+static uint32_t rx_buffer[BUF_SIZE] __attribute__((aligned(4096)));
+static uint32_t lengths[BUF_SIZE];
+
+// Bit n of the stream: 8N1 frames back to back, idle high after the last
+static int uart_level(const struct uart_line *uart, uint64_t bit)
+{
+	uint frame = bit / 10;
+	uint n = bit % 10;
+
+	if (frame >= uart->frames || n == 9)
+		return 1;
+	if (n == 0)
+		return 0;
+	return (text[frame % (sizeof(text) - 1)] >> (n - 1)) & 1;
+}
+
+static void uart_pins(void *ctx, uint64_t cycle, uint32_t out, uint32_t oe,
+		      uint32_t *ext_out, uint32_t *ext_oe)
+{
+	const struct uart_line *uart = ctx;
+	int level = 1;
+
+	(void)out;
+	(void)oe;
+	if (uart->baud)
+		level = uart_level(uart, (cycle - uart->start) * uart->baud / HOST_CLK_SYS_HZ);
+	*ext_oe = 1u << PROBE_UART_RX;
+	*ext_out = (uint32_t)level << PROBE_UART_RX;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// The bit time in PIO cycles, 0 if there is no consistent shortest pulse
+static float estimate_bit_time(uint32_t *samples, uint count)
+{
+	uint64_t sum = 0;
+	uint n = 0;
+
+	qsort(samples, count, sizeof(samples[0]), cmp_u32);
+	for (uint i = 0; i < count; i = n) {
+		for (n = i; n < count && samples[n] == samples[i]; n++)
+			;
+		if ((float)(n - i) / count < MIN_FREQUENCY)
+			continue;
+		for (n = i; n < count && samples[n] - samples[i] < samples[i] * 0.1f; n++)
+			sum += samples[n];
+		return (float)sum / (n - i);
+	}
+	return 0.0f;
+}
+
+int main(int argc, char **argv)
+{
+	static const uint32_t default_bauds[] = { 9600, 115200, 1000000, 3000000 };
+	struct uart_line uart = {
+		.frames = 32,
+	};
+	const uint32_t *bauds = default_bauds;
+	uint32_t *arg_bauds;
+	int baud_count = count_of(default_bauds);
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:")) != -1) {
+		switch (opt) {
+		case 'f':
+			uart.frames = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-f frames] [baud...]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (optind < argc) {
+		baud_count = argc - optind;
+		arg_bauds = calloc(baud_count, sizeof(arg_bauds[0]));
+		if (!arg_bauds) {
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+		for (int i = 0; i < baud_count; i++)
+			arg_bauds[i] = strtoul(argv[optind + i], NULL, 0);
+		bauds = arg_bauds;
+	}
+
+	PIO pio = pio1;
+	uint sm = pio_claim_unused_sm(pio, true);
+	uint offset = pio_add_program(pio, &autobaud_program);
+	uint chan = dma_claim_unused_channel(true);
+	dma_channel_config c = dma_channel_get_default_config(chan);
+
+	channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+	channel_config_set_read_increment(&c, false);
+	channel_config_set_write_increment(&c, true);
+	channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+	channel_config_set_ring(&c, true, 12);
+	// Stands in for autobaud.c's control channel reloading the count
+	dma_channel_configure(chan, &c, rx_buffer, &pio->rxf[sm], 0xffffffffu, false);
+
+	pio_sim_attach(uart_pins, &uart);
+	autobaud_program_init(pio, sm, offset, PROBE_UART_RX, 1.0f);
+	pio_sm_set_enabled(pio, sm, true);
+	dma_channel_start(chan);
+
+	for (int i = 0; i < baud_count; i++) {
+		uint32_t baud = bauds[i];
+
+		if (!baud)
+			continue;
+
+		uintptr_t first = dma_channel_hw_addr(chan)->write_addr;
+		uart.baud = baud;
+		uart.start = pio_sim_cycles();
+		pio_sim_clear_stats();
+		pio_sim_run((uint64_t)(uart.frames + 1) * 10 * HOST_CLK_SYS_HZ / baud);
+
+		uintptr_t last = dma_channel_hw_addr(chan)->write_addr;
+		uint count = 0;
+		for (uint n = (first - (uintptr_t)rx_buffer) / 4; n != (last - (uintptr_t)rx_buffer) / 4;
+		     n = (n + 1) % BUF_SIZE)
+			lengths[count++] = (UINT32_MAX - rx_buffer[n]) * 2;
+
+		float bit_time = count ? estimate_bit_time(lengths, count) : 0.0f;
+		float estimate = bit_time ? HOST_CLK_SYS_HZ / bit_time : 0.0f;
+		printf("baud %lu estimate %.0f error %.2f%% samples %u dropped %llu\n",
+		       (unsigned long)baud, estimate, estimate ? 100.0f * (estimate - baud) / baud : 100.0f,
+		       count, (unsigned long long)pio_sim_sm_stats(1, sm)->rx_dropped);
+		uart.baud = 0;
+	}
+	return 0;
+}
@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Runs DAP requests as dap_replay -s does, but through the real src/probe.c
+ * and pioasm output of the board's probe program on the PIO model in
+ * pio_sim.h, with the simulated target from swd_sim.h on the pads. Time is
+ * the model's: clk_sys cycles at 125 MHz.
+ *
+ * Responses go to stdout. Writes return before they are clocked out, so each
+ * request is left to run until the probe SM is idle before the next one.
+ * For every request a line goes to stderr with the command, the clk_sys
+ * cycles and microseconds it took to the SM going idle, its SWCLK rising
+ * edges, the bus utilisation - the share of the time SWCLK was running,
+ * edges times the SWCLK period - and the ticks the probe SM spent stalled on
+ * an empty TX FIFO, a full RX FIFO or a wait.
+ *
+ * -n, -l, -w, -f and -p are as for dap_replay. -c sets the clk_sys cycles
+ * each register access by the CPU takes (default 4), -d the clk_sys cycles
+ * from an SWCLK rising edge to the target's new level on SWDIO (default 2).
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "DAP_config.h"
+#include "hardware/clocks.h"
+#include "dap_host.h"
+#include "pio_sim.h"
+#include "probe.h"
+#include "swd_bus.h"
+#include "swd_sim.h"
+
+#define MAX_REQUESTS 4096
+// A second of clk_sys, far beyond anything a queued stream takes
+#define PIO_IDLE_TIMEOUT HOST_CLK_SYS_HZ
+
+static uint8_t requests[MAX_REQUESTS][DAP_PACKET_SIZE];
+static uint8_t response[DAP_PACKET_SIZE];
+
+static int parse_hex(const char *line, uint8_t *buf)
+{
+	int len = 0;
+	int nibbles = 0;
+
+	for (; *line && *line != '#'; line++) {
+		if (isspace((unsigned char)*line))
+			continue;
+		if (!isxdigit((unsigned char)*line) || len == DAP_PACKET_SIZE)
+			return -1;
+		int v = isdigit((unsigned char)*line) ? *line - '0' : (tolower((unsigned char)*line) - 'a' + 10);
+		buf[len] = (buf[len] << 4) | v;
+		if (++nibbles % 2 == 0)
+			len++;
+	}
+	return nibbles % 2 ? -1 : len;
+}
+
+int main(int argc, char **argv)
+{
+	char line[4 * DAP_PACKET_SIZE];
+	unsigned long passes = 1;
+	int count = 0;
+	int opt;
+	swd_sim_config_t config;
+	struct swd_bus bus;
+	const pio_sim_sm_stats_t *sm = pio_sim_sm_stats(0, PROBE_SM);
+	uint64_t total_cycles = 0;
+	uint64_t total_edges = 0;
+
+	swd_bus_init(&bus, NULL);
+	swd_sim_default_config(&config);
+	while ((opt = getopt(argc, argv, "n:l:w:f:p:c:d:")) != -1) {
+		switch (opt) {
+		case 'n':
+			passes = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			config.mem_latency = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			if (sscanf(optarg, "%u,%u", &config.wait_every, &config.wait_burst) != 2)
+				goto usage;
+			break;
+		case 'f':
+			config.fault_every = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			config.parity_error_every = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			pio_sim_set_cpu_cycles(strtoul(optarg, NULL, 0));
+			break;
+		case 'd':
+			bus.target_delay = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+
+	while (fgets(line, sizeof(line), stdin)) {
+		if (count == MAX_REQUESTS) {
+			fprintf(stderr, "more than %d requests\n", MAX_REQUESTS);
+			return 1;
+		}
+		memset(requests[count], 0, DAP_PACKET_SIZE);
+		int len = parse_hex(line, requests[count]);
+		if (len < 0) {
+			fprintf(stderr, "bad request: %s", line);
+			return 1;
+		}
+		if (len)
+			count++;
+	}
+
+	bus.sim = swd_sim_create(&config);
+	if (!bus.sim) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	pio_sim_attach(swd_bus_pins, &bus);
+
+	dap_host_init();
+	for (unsigned long pass = 1; pass <= passes; pass++) {
+		for (int i = 0; i < count; i++) {
+			uint64_t start = pio_sim_cycles();
+			uint64_t edges = bus.edges;
+			pio_sim_clear_stats();
+
+			uint32_t resp_len = dap_host_execute(requests[i], response);
+			pio_sim_run_until_idle(0, PROBE_SM, PIO_IDLE_TIMEOUT);
+
+			uint64_t cycles = pio_sim_cycles() - start;
+			const probe_clock_t *clk = probe_get_swclk();
+			double period = clk->cycles * (clk->div_int + clk->div_frac / 256.0);
+
+			edges = bus.edges - edges;
+			total_cycles += cycles;
+			total_edges += edges;
+			if (pass < passes)
+				continue;
+			for (uint32_t n = 0; n < resp_len; n++)
+				printf("%02x", response[n]);
+			printf("\n");
+			fprintf(stderr, "cmd %02x cycles %llu us %.2f edges %llu busy %.1f%% tx_stall %llu rx_stall %llu wait_stall %llu\n",
+				requests[i][0], (unsigned long long)cycles, cycles / (HOST_CLK_SYS_HZ / 1e6),
+				(unsigned long long)edges, cycles ? 100.0 * MIN(edges * period, cycles) / cycles : 0.0,
+				(unsigned long long)sm->tx_stall, (unsigned long long)sm->rx_stall,
+				(unsigned long long)sm->wait_stall);
+		}
+	}
+
+	const swd_sim_stats_t *stats = swd_sim_get_stats(bus.sim);
+
+	fprintf(stderr, "total cycles %llu edges %llu\n",
+		(unsigned long long)total_cycles, (unsigned long long)total_edges);
+	fprintf(stderr, "requests %u ok %u wait %u fault %u no_response %u protocol_errors %u\n",
+		stats->requests, stats->acks_ok, stats->acks_wait, stats->acks_fault,
+		stats->no_response, stats->protocol_errors);
+	fprintf(stderr, "contention %u undriven %u wdata_errors %u\n",
+		stats->contention, stats->undriven, stats->wdata_errors);
+	swd_sim_destroy(bus.sim);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-n passes] [-l latency] [-w every,burst] [-f every] [-p every] [-c cpu_cycles] [-d delay] < requests\n",
+		argv[0]);
+	return 2;
+}
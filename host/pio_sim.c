@@ -0,0 +1,1028 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+#include "pio_sim.h"
+
+#define SIM_FIFO_DEPTH          8
+
+// FDEBUG is write-1-to-clear, which a plain struct cannot do. The model
+// publishes it with this reserved bit set, so a CPU write shows up as the
+// bit gone and the written value is taken as the bits to clear.
+#define SIM_FDEBUG_MARK         (1u << 31)
+
+enum sim_result {
+    SIM_DONE,
+    SIM_STALL_TX,
+    SIM_STALL_RX,
+    SIM_STALL_WAIT,
+};
+
+struct sim_sm {
+    bool claimed;
+    bool enabled;
+    uint pc;
+    uint32_t x;
+    uint32_t y;
+    uint32_t isr;
+    uint32_t osr;
+    uint isr_count;
+    uint osr_count;
+    uint delay;
+    // Clock divider phase, in 1/256ths of a clk_sys cycle
+    uint32_t div_acc;
+    // Instruction from pio_sm_exec(), or an out/mov exec, run before the
+    // next fetch
+    bool exec_pending;
+    uint16_t exec_instr;
+    // Set by an irq wait once the flag is raised
+    bool irq_waiting;
+    // The last tick stalled on a pull from an empty TX FIFO
+    bool tx_stalled;
+    uint32_t tx[SIM_FIFO_DEPTH];
+    uint tx_rd;
+    uint tx_level;
+    uint32_t rx[SIM_FIFO_DEPTH];
+    uint rx_rd;
+    uint rx_level;
+    pio_sim_sm_stats_t stats;
+};
+
+struct sim_pio {
+    pio_hw_t hw;
+    uint32_t fdebug;
+    // Instruction memory in use
+    uint32_t used;
+    // Output levels and enables of the block, shared by its state machines
+    uint32_t pin_out;
+    uint32_t pin_oe;
+    uint8_t irq;
+    struct sim_sm sm[NUM_PIO_STATE_MACHINES];
+};
+
+static struct {
+    struct sim_pio pio[NUM_PIOS];
+    dma_channel_hw_t dma[NUM_DMA_CHANNELS];
+    uint16_t dma_claimed;
+    // Channel to look at first, so busy channels take turns on the bus
+    uint dma_next;
+    uint64_t now;
+    uint cpu_cycles;
+    // Pad levels one and two cycles ago, the input synchroniser
+    uint32_t sync[2];
+    pio_sim_pins_fn pins;
+    void *pins_ctx;
+} sim = {
+    .cpu_cycles = 4,
+};
+
+static inline uint32_t rotr(uint32_t v, uint n)
+{
+    n &= 31;
+    return n ? (v >> n) | (v << (32 - n)) : v;
+}
+
+static inline uint32_t bit_mask(uint bits)
+{
+    return bits >= 32 ? 0xffffffffu : (1u << bits) - 1;
+}
+
+static inline uint field(uint32_t reg, uint lsb, uint bits)
+{
+    return (reg >> lsb) & bit_mask(bits);
+}
+
+static inline struct sim_pio *sim_pio(PIO pio)
+{
+    return &sim.pio[pio == &sim.pio[1].hw];
+}
+
+/* FIFOs */
+
+static uint tx_depth(const struct sim_pio *p, uint smi)
+{
+    uint32_t shiftctrl = p->hw.sm[smi].shiftctrl;
+
+    if (shiftctrl & (1u << PIO_SM0_SHIFTCTRL_FJOIN_TX_LSB))
+        return 8;
+    return shiftctrl & (1u << PIO_SM0_SHIFTCTRL_FJOIN_RX_LSB) ? 0 : 4;
+}
+
+static uint rx_depth(const struct sim_pio *p, uint smi)
+{
+    uint32_t shiftctrl = p->hw.sm[smi].shiftctrl;
+
+    if (shiftctrl & (1u << PIO_SM0_SHIFTCTRL_FJOIN_RX_LSB))
+        return 8;
+    return shiftctrl & (1u << PIO_SM0_SHIFTCTRL_FJOIN_TX_LSB) ? 0 : 4;
+}
+
+static void tx_push(struct sim_pio *p, uint smi, uint32_t data)
+{
+    struct sim_sm *sm = &p->sm[smi];
+
+    if (sm->tx_level >= tx_depth(p, smi)) {
+        p->fdebug |= 1u << (PIO_FDEBUG_TXOVER_LSB + smi);
+        return;
+    }
+    sm->tx[(sm->tx_rd + sm->tx_level++) % SIM_FIFO_DEPTH] = data;
+}
+
+static uint32_t tx_pop(struct sim_sm *sm)
+{
+    uint32_t data = sm->tx[sm->tx_rd];
+
+    sm->tx_rd = (sm->tx_rd + 1) % SIM_FIFO_DEPTH;
+    sm->tx_level--;
+    return data;
+}
+
+static void rx_push(struct sim_sm *sm, uint32_t data)
+{
+    sm->rx[(sm->rx_rd + sm->rx_level++) % SIM_FIFO_DEPTH] = data;
+}
+
+static uint32_t rx_pop(struct sim_pio *p, uint smi)
+{
+    struct sim_sm *sm = &p->sm[smi];
+    uint32_t data;
+
+    if (!sm->rx_level) {
+        p->fdebug |= 1u << (PIO_FDEBUG_RXUNDER_LSB + smi);
+        return 0;
+    }
+    data = sm->rx[sm->rx_rd];
+    sm->rx_rd = (sm->rx_rd + 1) % SIM_FIFO_DEPTH;
+    sm->rx_level--;
+    return data;
+}
+
+/* State machines */
+
+static void write_pins(struct sim_pio *p, uint base, uint count, uint32_t data, bool dirs)
+{
+    uint32_t *reg = dirs ? &p->pin_oe : &p->pin_out;
+
+    for (uint i = 0; i < count; i++) {
+        uint pin = (base + i) % 32;
+        *reg = (*reg & ~(1u << pin)) | (((data >> i) & 1u) << pin);
+    }
+}
+
+static uint32_t sm_status(const struct sim_pio *p, uint smi)
+{
+    uint32_t execctrl = p->hw.sm[smi].execctrl;
+    uint n = field(execctrl, PIO_SM0_EXECCTRL_STATUS_N_LSB, 4);
+    uint level = execctrl & (1u << PIO_SM0_EXECCTRL_STATUS_SEL_LSB) ? p->sm[smi].rx_level : p->sm[smi].tx_level;
+
+    return level < n ? 0xffffffffu : 0;
+}
+
+static void sm_jump(struct sim_sm *sm, uint addr, bool *jumped)
+{
+    sm->pc = addr & 0x1f;
+    *jumped = true;
+}
+
+static enum sim_result sm_push(struct sim_pio *p, uint smi, bool block)
+{
+    struct sim_sm *sm = &p->sm[smi];
+
+    if (sm->rx_level >= rx_depth(p, smi)) {
+        if (block) {
+            p->fdebug |= 1u << (PIO_FDEBUG_RXSTALL_LSB + smi);
+            return SIM_STALL_RX;
+        }
+        sm->stats.rx_dropped++;
+    } else {
+        rx_push(sm, sm->isr);
+    }
+    sm->isr = 0;
+    sm->isr_count = 0;
+    return SIM_DONE;
+}
+
+// Runs one instruction on a state machine. A stalled instruction has no
+// effect and is run again on the next tick.
+static enum sim_result sm_execute(struct sim_pio *p, uint smi, uint16_t instr, uint32_t in, bool *jumped)
+{
+    struct sim_sm *sm = &p->sm[smi];
+    pio_sm_hw_t *regs = &p->hw.sm[smi];
+    uint pinctrl = regs->pinctrl;
+    uint shiftctrl = regs->shiftctrl;
+    uint push_thresh = field(shiftctrl, PIO_SM0_SHIFTCTRL_PUSH_THRESH_LSB, 5);
+    uint pull_thresh = field(shiftctrl, PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB, 5);
+    bool in_right = shiftctrl & (1u << PIO_SM0_SHIFTCTRL_IN_SHIFTDIR_LSB);
+    bool out_right = shiftctrl & (1u << PIO_SM0_SHIFTCTRL_OUT_SHIFTDIR_LSB);
+    uint in_base = field(pinctrl, PIO_SM0_PINCTRL_IN_BASE_LSB, 5);
+    uint op = (instr >> 5) & 0x7;
+    uint index = instr & 0x1f;
+    uint32_t data = 0;
+
+    if (!push_thresh)
+        push_thresh = 32;
+    if (!pull_thresh)
+        pull_thresh = 32;
+
+    switch (instr >> 13) {
+    case 0: { // jmp
+        bool cond;
+        switch (op) {
+        case 0: cond = true; break;
+        case 1: cond = !sm->x; break;
+        case 2: cond = sm->x--; break;
+        case 3: cond = !sm->y; break;
+        case 4: cond = sm->y--; break;
+        case 5: cond = sm->x != sm->y; break;
+        case 6: cond = (in >> field(regs->execctrl, PIO_SM0_EXECCTRL_JMP_PIN_LSB, 5)) & 1u; break;
+        default: cond = sm->osr_count < pull_thresh; break;
+        }
+        if (cond)
+            sm_jump(sm, index, jumped);
+        return SIM_DONE;
+    }
+    case 1: { // wait
+        bool polarity = instr & 0x80;
+        bool level;
+        uint irq = (index & 0x10) ? (index & 0x4) | ((index + smi) & 0x3) : index & 0x7;
+        switch (op & 0x3) {
+        case 0: level = (in >> index) & 1u; break;
+        case 1: level = (in >> ((in_base + index) % 32)) & 1u; break;
+        case 2: level = (p->irq >> irq) & 1u; break;
+        default: level = !polarity; break;
+        }
+        if (level != polarity)
+            return SIM_STALL_WAIT;
+        if ((op & 0x3) == 2 && polarity)
+            p->irq &= ~(1u << irq);
+        return SIM_DONE;
+    }
+    case 2: { // in
+        uint bits = index ? index : 32;
+        bool autopush = shiftctrl & (1u << PIO_SM0_SHIFTCTRL_AUTOPUSH_LSB);
+        if (autopush && sm->isr_count >= push_thresh && sm->rx_level >= rx_depth(p, smi)) {
+            p->fdebug |= 1u << (PIO_FDEBUG_RXSTALL_LSB + smi);
+            return SIM_STALL_RX;
+        }
+        switch (op) {
+        case 0: data = rotr(in, in_base); break;
+        case 1: data = sm->x; break;
+        case 2: data = sm->y; break;
+        case 6: data = sm->isr; break;
+        case 7: data = sm->osr; break;
+        default: data = 0; break;
+        }
+        data &= bit_mask(bits);
+        if (bits == 32)
+            sm->isr = data;
+        else if (in_right)
+            sm->isr = (sm->isr >> bits) | (data << (32 - bits));
+        else
+            sm->isr = (sm->isr << bits) | data;
+        sm->isr_count = MIN(sm->isr_count + bits, 32);
+        if (autopush && sm->isr_count >= push_thresh)
+            sm_push(p, smi, true);
+        return SIM_DONE;
+    }
+    case 3: { // out
+        uint bits = index ? index : 32;
+        if ((shiftctrl & (1u << PIO_SM0_SHIFTCTRL_AUTOPULL_LSB)) && sm->osr_count >= pull_thresh) {
+            if (!sm->tx_level) {
+                p->fdebug |= 1u << (PIO_FDEBUG_TXSTALL_LSB + smi);
+                return SIM_STALL_TX;
+            }
+            sm->osr = tx_pop(sm);
+            sm->osr_count = 0;
+        }
+        if (bits == 32) {
+            data = sm->osr;
+            sm->osr = 0;
+        } else if (out_right) {
+            data = sm->osr & bit_mask(bits);
+            sm->osr >>= bits;
+        } else {
+            data = sm->osr >> (32 - bits);
+            sm->osr <<= bits;
+        }
+        sm->osr_count = MIN(sm->osr_count + bits, 32);
+        switch (op) {
+        case 0:
+        case 4:
+            write_pins(p, field(pinctrl, PIO_SM0_PINCTRL_OUT_BASE_LSB, 5),
+                       field(pinctrl, PIO_SM0_PINCTRL_OUT_COUNT_LSB, 6), data, op == 4);
+            break;
+        case 1: sm->x = data; break;
+        case 2: sm->y = data; break;
+        case 5: sm_jump(sm, data, jumped); break;
+        case 6:
+            sm->isr = data;
+            sm->isr_count = bits;
+            break;
+        case 7:
+            sm->exec_pending = true;
+            sm->exec_instr = data;
+            break;
+        default: break;
+        }
+        return SIM_DONE;
+    }
+    case 4: // push, pull
+        if (!(instr & 0x80)) {
+            if ((instr & 0x40) && sm->isr_count < push_thresh)
+                return SIM_DONE;
+            return sm_push(p, smi, instr & 0x20);
+        }
+        if ((instr & 0x40) && sm->osr_count < pull_thresh)
+            return SIM_DONE;
+        if (!sm->tx_level) {
+            if (instr & 0x20) {
+                p->fdebug |= 1u << (PIO_FDEBUG_TXSTALL_LSB + smi);
+                return SIM_STALL_TX;
+            }
+            sm->osr = sm->x;
+        } else {
+            sm->osr = tx_pop(sm);
+        }
+        sm->osr_count = 0;
+        return SIM_DONE;
+    case 5: { // mov
+        switch (instr & 0x7) {
+        case 0: data = rotr(in, in_base); break;
+        case 1: data = sm->x; break;
+        case 2: data = sm->y; break;
+        case 5: data = sm_status(p, smi); break;
+        case 6: data = sm->isr; break;
+        case 7: data = sm->osr; break;
+        default: data = 0; break;
+        }
+        if (((instr >> 3) & 0x3) == 1) {
+            data = ~data;
+        } else if (((instr >> 3) & 0x3) == 2) {
+            uint32_t rev = 0;
+            for (uint i = 0; i < 32; i++)
+                rev |= ((data >> i) & 1u) << (31 - i);
+            data = rev;
+        }
+        switch (op) {
+        case 0:
+            write_pins(p, field(pinctrl, PIO_SM0_PINCTRL_OUT_BASE_LSB, 5),
+                       field(pinctrl, PIO_SM0_PINCTRL_OUT_COUNT_LSB, 6), data, false);
+            break;
+        case 1: sm->x = data; break;
+        case 2: sm->y = data; break;
+        case 4:
+            sm->exec_pending = true;
+            sm->exec_instr = data;
+            break;
+        case 5: sm_jump(sm, data, jumped); break;
+        case 6:
+            sm->isr = data;
+            sm->isr_count = 0;
+            break;
+        case 7:
+            sm->osr = data;
+            sm->osr_count = 0;
+            break;
+        default: break;
+        }
+        return SIM_DONE;
+    }
+    case 6: { // irq
+        uint irq = (index & 0x10) ? (index & 0x4) | ((index + smi) & 0x3) : index & 0x7;
+        if (sm->irq_waiting) {
+            if (p->irq & (1u << irq))
+                return SIM_STALL_WAIT;
+            sm->irq_waiting = false;
+            return SIM_DONE;
+        }
+        if (instr & 0x40) {
+            p->irq &= ~(1u << irq);
+            return SIM_DONE;
+        }
+        p->irq |= 1u << irq;
+        if (instr & 0x20) {
+            sm->irq_waiting = true;
+            return SIM_STALL_WAIT;
+        }
+        return SIM_DONE;
+    }
+    default: // set
+        switch (op) {
+        case 0:
+        case 4:
+            write_pins(p, field(pinctrl, PIO_SM0_PINCTRL_SET_BASE_LSB, 5),
+                       field(pinctrl, PIO_SM0_PINCTRL_SET_COUNT_LSB, 3), index, op == 4);
+            break;
+        case 1: sm->x = index; break;
+        case 2: sm->y = index; break;
+        default: break;
+        }
+        return SIM_DONE;
+    }
+}
+
+// Side-set takes effect as the instruction is issued, stalled or not, and
+// the delay once it completes
+static void sm_side_set(struct sim_pio *p, uint smi, uint16_t instr, uint *delay)
+{
+    pio_sm_hw_t *regs = &p->hw.sm[smi];
+    uint count = field(regs->pinctrl, PIO_SM0_PINCTRL_SIDESET_COUNT_LSB, 3);
+    bool opt = regs->execctrl & (1u << PIO_SM0_EXECCTRL_SIDE_EN_LSB);
+    uint delay_bits = 5 - count;
+    uint bits = (instr >> 8) & 0x1f;
+
+    *delay = bits & bit_mask(delay_bits);
+    if (opt) {
+        if (!(bits & 0x10))
+            return;
+        count--;
+    }
+    if (count)
+        write_pins(p, field(regs->pinctrl, PIO_SM0_PINCTRL_SIDESET_BASE_LSB, 5), count,
+                   bits >> delay_bits, regs->execctrl & (1u << PIO_SM0_EXECCTRL_SIDE_PINDIR_LSB));
+}
+
+static void sm_tick(struct sim_pio *p, uint smi, uint32_t in)
+{
+    struct sim_sm *sm = &p->sm[smi];
+    pio_sm_hw_t *regs = &p->hw.sm[smi];
+    bool forced = sm->exec_pending;
+    bool jumped = false;
+    uint16_t instr;
+    uint delay;
+    enum sim_result result;
+
+    sm->stats.ticks++;
+    if (!forced && sm->delay) {
+        sm->delay--;
+        sm->stats.delay++;
+        return;
+    }
+
+    if (forced) {
+        instr = sm->exec_instr;
+        sm->exec_pending = false;
+        sm->delay = 0;
+    } else {
+        instr = p->hw.instr_mem[sm->pc];
+    }
+    sm_side_set(p, smi, instr, &delay);
+    result = sm_execute(p, smi, instr, in, &jumped);
+    sm->tx_stalled = result == SIM_STALL_TX;
+    switch (result) {
+    case SIM_STALL_TX:
+        sm->stats.tx_stall++;
+        break;
+    case SIM_STALL_RX:
+        sm->stats.rx_stall++;
+        break;
+    case SIM_STALL_WAIT:
+        sm->stats.wait_stall++;
+        break;
+    default:
+        break;
+    }
+    if (result != SIM_DONE) {
+        // A stalled forced instruction stays latched
+        if (forced && !sm->exec_pending) {
+            sm->exec_pending = true;
+            sm->exec_instr = instr;
+        }
+        return;
+    }
+
+    sm->stats.executed++;
+    sm->delay = delay;
+    if (!jumped && !forced) {
+        if (sm->pc == field(regs->execctrl, PIO_SM0_EXECCTRL_WRAP_TOP_LSB, 5))
+            sm->pc = field(regs->execctrl, PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB, 5);
+        else
+            sm->pc = (sm->pc + 1) % PIO_INSTRUCTION_COUNT;
+    }
+}
+
+static void sm_cycle(struct sim_pio *p, uint smi, uint32_t in)
+{
+    struct sim_sm *sm = &p->sm[smi];
+    uint32_t clkdiv = p->hw.sm[smi].clkdiv;
+    uint32_t div = (clkdiv >> PIO_SM0_CLKDIV_FRAC_LSB) & 0xffffffu;
+
+    if (!sm->enabled) {
+        // Forced instructions run with the state machine stopped too
+        if (sm->exec_pending)
+            sm_tick(p, smi, in);
+        return;
+    }
+    sm->stats.cycles++;
+    if (!(div >> 8))
+        div = 65536u << 8;
+    sm->div_acc += 256;
+    if (sm->div_acc < div)
+        return;
+    sm->div_acc -= div;
+    sm_tick(p, smi, in);
+}
+
+/* DMA */
+
+static bool dma_dreq(uint treq)
+{
+    struct sim_pio *p;
+    uint smi = treq & 0x3;
+
+    if (treq == DREQ_FORCE)
+        return true;
+    if (treq >= DREQ_PIO1_RX0 + NUM_PIO_STATE_MACHINES)
+        return false;
+    p = &sim.pio[treq >= DREQ_PIO1_TX0];
+    if (treq & 0x4)
+        return p->sm[smi].rx_level > 0;
+    return p->sm[smi].tx_level < tx_depth(p, smi);
+}
+
+// The FIFO behind an address, if it is one
+static bool dma_fifo(uintptr_t addr, bool tx, struct sim_pio **pio, uint *smi)
+{
+    for (uint i = 0; i < NUM_PIOS; i++) {
+        for (uint s = 0; s < NUM_PIO_STATE_MACHINES; s++) {
+            if (addr == (uintptr_t)(tx ? &sim.pio[i].hw.txf[s] : &sim.pio[i].hw.rxf[s])) {
+                *pio = &sim.pio[i];
+                *smi = s;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static uintptr_t dma_next_addr(uintptr_t addr, uint size, uint ring)
+{
+    uintptr_t mask;
+
+    if (!ring)
+        return addr + size;
+    mask = ((uintptr_t)1 << ring) - 1;
+    return (addr & ~mask) | ((addr + size) & mask);
+}
+
+static void dma_transfer(dma_channel_hw_t *ch)
+{
+    uint32_t ctrl = ch->ctrl_trig;
+    uint size = 1u << field(ctrl, DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB, 2);
+    uint ring = field(ctrl, DMA_CH0_CTRL_TRIG_RING_SIZE_LSB, 4);
+    bool ring_write = ctrl & (1u << DMA_CH0_CTRL_TRIG_RING_SEL_LSB);
+    struct sim_pio *p;
+    uint smi;
+    uint32_t data = 0;
+
+    if (dma_fifo(ch->read_addr, false, &p, &smi))
+        data = rx_pop(p, smi);
+    else
+        memcpy(&data, (const void *)ch->read_addr, size);
+    if (dma_fifo(ch->write_addr, true, &p, &smi))
+        tx_push(p, smi, data);
+    else
+        memcpy((void *)ch->write_addr, &data, size);
+
+    if (ctrl & (1u << DMA_CH0_CTRL_TRIG_INCR_READ_LSB))
+        ch->read_addr = dma_next_addr(ch->read_addr, size, ring_write ? 0 : ring);
+    if (ctrl & (1u << DMA_CH0_CTRL_TRIG_INCR_WRITE_LSB))
+        ch->write_addr = dma_next_addr(ch->write_addr, size, ring_write ? ring : 0);
+    if (!--ch->transfer_count)
+        ch->ctrl_trig &= ~(1u << DMA_CH0_CTRL_TRIG_BUSY_LSB);
+}
+
+// One transfer per cycle across all channels
+static void dma_cycle(void)
+{
+    for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+        uint n = (sim.dma_next + i) % NUM_DMA_CHANNELS;
+        dma_channel_hw_t *ch = &sim.dma[n];
+
+        if (!(ch->ctrl_trig & (1u << DMA_CH0_CTRL_TRIG_BUSY_LSB)) ||
+            !dma_dreq(field(ch->ctrl_trig, DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB, 6)))
+            continue;
+        dma_transfer(ch);
+        sim.dma_next = n + 1;
+        return;
+    }
+}
+
+/* Pads and time */
+
+static void sim_cycle(void)
+{
+    uint32_t out = (host_gpio.sio_out & host_gpio.func_sio) |
+                   (sim.pio[0].pin_out & host_gpio.func_pio0) |
+                   (sim.pio[1].pin_out & host_gpio.func_pio1);
+    uint32_t oe = (host_gpio.sio_oe & host_gpio.func_sio) |
+                  (sim.pio[0].pin_oe & host_gpio.func_pio0) |
+                  (sim.pio[1].pin_oe & host_gpio.func_pio1);
+    uint32_t ext_out = 0;
+    uint32_t ext_oe = 0;
+    uint32_t level;
+
+    if (sim.pins)
+        sim.pins(sim.pins_ctx, sim.now, out, oe, &ext_out, &ext_oe);
+    ext_oe &= ~oe;
+    level = (out & oe) | (ext_out & ext_oe);
+    level |= ~(oe | ext_oe) & (host_gpio.pull_up | (host_gpio.in & ~host_gpio.pull_down));
+    host_gpio.in = level;
+
+    for (uint i = 0; i < NUM_PIOS; i++) {
+        struct sim_pio *p = &sim.pio[i];
+        uint32_t bypass = p->hw.input_sync_bypass;
+        uint32_t in = (sim.sync[1] & ~bypass) | (level & bypass);
+
+        for (uint s = 0; s < NUM_PIO_STATE_MACHINES; s++)
+            sm_cycle(p, s, in);
+    }
+    dma_cycle();
+
+    sim.sync[1] = sim.sync[0];
+    sim.sync[0] = level;
+    sim.now++;
+}
+
+// Take in what the CPU wrote to the stand-in registers since the last run
+static void sim_sync_cpu(void)
+{
+    for (uint i = 0; i < NUM_PIOS; i++) {
+        struct sim_pio *p = &sim.pio[i];
+
+        if (!(p->hw.fdebug & SIM_FDEBUG_MARK))
+            p->fdebug &= ~p->hw.fdebug;
+    }
+}
+
+static void sim_publish(void)
+{
+    for (uint i = 0; i < NUM_PIOS; i++) {
+        struct sim_pio *p = &sim.pio[i];
+        uint32_t fstat = 0;
+
+        p->hw.fdebug = p->fdebug | SIM_FDEBUG_MARK;
+        for (uint s = 0; s < NUM_PIO_STATE_MACHINES; s++) {
+            struct sim_sm *sm = &p->sm[s];
+
+            p->hw.sm[s].addr = sm->pc;
+            fstat |= (uint32_t)(sm->rx_level >= rx_depth(p, s)) << s;
+            fstat |= (uint32_t)!sm->rx_level << (8 + s);
+            fstat |= (uint32_t)(sm->tx_level >= tx_depth(p, s)) << (16 + s);
+            fstat |= (uint32_t)!sm->tx_level << (24 + s);
+        }
+        p->hw.fstat = fstat;
+        p->hw.irq = p->irq;
+    }
+}
+
+void pio_sim_run(uint64_t cycles)
+{
+    sim_sync_cpu();
+    while (cycles--)
+        sim_cycle();
+    sim_publish();
+}
+
+uint64_t pio_sim_run_until_idle(uint pio, uint sm, uint64_t max)
+{
+    struct sim_pio *p = &sim.pio[pio];
+    uintptr_t txf = (uintptr_t)&p->hw.txf[sm];
+    uint64_t start = sim.now;
+
+    sim_sync_cpu();
+    while (sim.now - start < max) {
+        bool feeding = false;
+        for (uint i = 0; i < NUM_DMA_CHANNELS; i++)
+            feeding |= (sim.dma[i].ctrl_trig & (1u << DMA_CH0_CTRL_TRIG_BUSY_LSB)) && sim.dma[i].write_addr == txf;
+        if (!p->sm[sm].enabled || (!feeding && !p->sm[sm].tx_level && p->sm[sm].tx_stalled))
+            break;
+        sim_cycle();
+    }
+    sim_publish();
+    return sim.now - start;
+}
+
+static inline void sim_access(void)
+{
+    pio_sim_run(sim.cpu_cycles);
+}
+
+void pio_sim_attach(pio_sim_pins_fn pins, void *ctx)
+{
+    sim.pins = pins;
+    sim.pins_ctx = ctx;
+}
+
+void pio_sim_set_cpu_cycles(uint cycles)
+{
+    sim.cpu_cycles = cycles;
+}
+
+uint64_t pio_sim_cycles(void)
+{
+    return sim.now;
+}
+
+const pio_sim_sm_stats_t *pio_sim_sm_stats(uint pio, uint sm)
+{
+    return &sim.pio[pio].sm[sm].stats;
+}
+
+void pio_sim_clear_stats(void)
+{
+    for (uint i = 0; i < NUM_PIOS; i++)
+        for (uint s = 0; s < NUM_PIO_STATE_MACHINES; s++)
+            memset(&sim.pio[i].sm[s].stats, 0, sizeof(sim.pio[i].sm[s].stats));
+}
+
+/* hardware/pio.h */
+
+PIO pio_host_instance(uint index)
+{
+    sim_access();
+    return &sim.pio[index].hw;
+}
+
+uint pio_get_index(PIO pio)
+{
+    return pio == &sim.pio[1].hw;
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx)
+{
+    return pio_get_index(pio) * DREQ_PIO1_TX0 + (is_tx ? 0 : DREQ_PIO0_RX0) + sm;
+}
+
+void pio_gpio_init(PIO pio, uint pin)
+{
+    gpio_set_function(pin, pio_get_index(pio) ? GPIO_FUNC_PIO1 : GPIO_FUNC_PIO0);
+}
+
+static int find_offset(const struct sim_pio *p, const pio_program_t *program)
+{
+    uint32_t mask = bit_mask(program->length);
+
+    if (program->origin >= 0)
+        return (p->used & (mask << program->origin)) ? -1 : program->origin;
+    // As the SDK, from the top of instruction memory down
+    for (int offset = PIO_INSTRUCTION_COUNT - program->length; offset >= 0; offset--)
+        if (!(p->used & (mask << offset)))
+            return offset;
+    return -1;
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program)
+{
+    return find_offset(sim_pio(pio), program) >= 0;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program)
+{
+    struct sim_pio *p = sim_pio(pio);
+    int offset = find_offset(p, program);
+
+    if (offset < 0) {
+        fprintf(stderr, "pio_sim: no program space\n");
+        abort();
+    }
+    for (uint i = 0; i < program->length; i++) {
+        uint16_t instr = program->instructions[i];
+        if (_pio_major_instr_bits(instr) == pio_instr_bits_jmp)
+            instr += offset;
+        p->hw.instr_mem[offset + i] = instr;
+    }
+    p->used |= bit_mask(program->length) << offset;
+    return offset;
+}
+
+void pio_remove_program(PIO pio, const pio_program_t *program, uint loaded_offset)
+{
+    sim_pio(pio)->used &= ~(bit_mask(program->length) << loaded_offset);
+}
+
+void pio_sm_claim(PIO pio, uint sm)
+{
+    sim_pio(pio)->sm[sm].claimed = true;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+    struct sim_pio *p = sim_pio(pio);
+
+    for (uint s = 0; s < NUM_PIO_STATE_MACHINES; s++) {
+        if (!p->sm[s].claimed) {
+            p->sm[s].claimed = true;
+            return s;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "pio_sim: no free state machine\n");
+        abort();
+    }
+    return -1;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm)
+{
+    sim_pio(pio)->sm[sm].claimed = false;
+}
+
+int pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config)
+{
+    struct sim_pio *p = sim_pio(pio);
+    struct sim_sm *s = &p->sm[sm];
+
+    s->enabled = false;
+    p->hw.sm[sm].clkdiv = config->clkdiv;
+    p->hw.sm[sm].execctrl = config->execctrl;
+    p->hw.sm[sm].shiftctrl = config->shiftctrl;
+    p->hw.sm[sm].pinctrl = config->pinctrl;
+    pio_sm_clear_fifos(pio, sm);
+    p->fdebug &= ~(((1u << PIO_FDEBUG_RXSTALL_LSB) | (1u << PIO_FDEBUG_RXUNDER_LSB) |
+                    (1u << PIO_FDEBUG_TXOVER_LSB) | (1u << PIO_FDEBUG_TXSTALL_LSB)) << sm);
+    // Restart: empty shift registers, clock divider phase and delay reset
+    s->isr = 0;
+    s->isr_count = 0;
+    s->osr_count = 32;
+    s->delay = 0;
+    s->div_acc = 0;
+    s->exec_pending = false;
+    s->irq_waiting = false;
+    s->tx_stalled = false;
+    s->pc = initial_pc;
+    return 0;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)
+{
+    sim_access();
+    sim_pio(pio)->sm[sm].enabled = enabled;
+}
+
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac)
+{
+    sim_access();
+    sim_pio(pio)->hw.sm[sm].clkdiv = ((uint32_t)div_int << PIO_SM0_CLKDIV_INT_LSB) |
+                                     ((uint32_t)div_frac << PIO_SM0_CLKDIV_FRAC_LSB);
+}
+
+void pio_sm_set_clkdiv(PIO pio, uint sm, float div)
+{
+    pio_sm_config c;
+
+    sm_config_set_clkdiv(&c, div);
+    pio_sm_set_clkdiv_int_frac(pio, sm, c.clkdiv >> PIO_SM0_CLKDIV_INT_LSB,
+                               (c.clkdiv >> PIO_SM0_CLKDIV_FRAC_LSB) & 0xff);
+}
+
+void pio_sm_exec(PIO pio, uint sm, uint instr)
+{
+    struct sim_sm *s = &sim_pio(pio)->sm[sm];
+
+    sim_access();
+    s->exec_pending = true;
+    s->exec_instr = instr;
+}
+
+uint8_t pio_sm_get_pc(PIO pio, uint sm)
+{
+    sim_access();
+    return sim_pio(pio)->sm[sm].pc;
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm)
+{
+    struct sim_sm *s = &sim_pio(pio)->sm[sm];
+
+    sim_access();
+    s->tx_level = s->tx_rd = 0;
+    s->rx_level = s->rx_rd = 0;
+}
+
+int pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out)
+{
+    write_pins(sim_pio(pio), pin_base, pin_count, is_out ? 0xffffffffu : 0, true);
+    return 0;
+}
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm)
+{
+    sim_access();
+    return !sim_pio(pio)->sm[sm].rx_level;
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm)
+{
+    struct sim_pio *p = sim_pio(pio);
+
+    sim_access();
+    return p->sm[sm].tx_level >= tx_depth(p, sm);
+}
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm)
+{
+    sim_access();
+    return sim_pio(pio)->sm[sm].rx_level;
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm)
+{
+    sim_access();
+    return rx_pop(sim_pio(pio), sm);
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data)
+{
+    sim_access();
+    tx_push(sim_pio(pio), sm, data);
+}
+
+/* hardware/dma.h */
+
+void dma_channel_claim(uint channel)
+{
+    sim.dma_claimed |= 1u << channel;
+}
+
+int dma_claim_unused_channel(bool required)
+{
+    for (uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if (!(sim.dma_claimed & (1u << i))) {
+            dma_channel_claim(i);
+            return i;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "pio_sim: no free DMA channel\n");
+        abort();
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel)
+{
+    sim.dma_claimed &= ~(1u << channel);
+}
+
+dma_channel_hw_t *dma_channel_hw_addr(uint channel)
+{
+    sim_access();
+    return &sim.dma[channel];
+}
+
+void dma_channel_start(uint channel)
+{
+    dma_channel_hw_t *ch = &sim.dma[channel];
+
+    sim_access();
+    if ((ch->ctrl_trig & (1u << DMA_CH0_CTRL_TRIG_EN_LSB)) && ch->transfer_count)
+        ch->ctrl_trig |= 1u << DMA_CH0_CTRL_TRIG_BUSY_LSB;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger)
+{
+    dma_channel_hw_t *ch = &sim.dma[channel];
+
+    ch->read_addr = (uintptr_t)read_addr;
+    ch->write_addr = (uintptr_t)write_addr;
+    ch->transfer_count = transfer_count;
+    ch->ctrl_trig = config->ctrl & ~(1u << DMA_CH0_CTRL_TRIG_BUSY_LSB);
+    if (trigger)
+        dma_channel_start(channel);
+}
+
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count)
+{
+    sim.dma[channel].read_addr = (uintptr_t)read_addr;
+    sim.dma[channel].transfer_count = transfer_count;
+    dma_channel_start(channel);
+}
+
+void dma_channel_transfer_to_buffer_now(uint channel, volatile void *write_addr, uint32_t transfer_count)
+{
+    sim.dma[channel].write_addr = (uintptr_t)write_addr;
+    sim.dma[channel].transfer_count = transfer_count;
+    dma_channel_start(channel);
+}
+
+void dma_channel_abort(uint channel)
+{
+    sim_access();
+    sim.dma[channel].ctrl_trig &= ~(1u << DMA_CH0_CTRL_TRIG_BUSY_LSB);
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+    sim_access();
+    return sim.dma[channel].ctrl_trig & (1u << DMA_CH0_CTRL_TRIG_BUSY_LSB);
+}
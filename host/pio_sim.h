@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef PIO_SIM_H
+#define PIO_SIM_H
+
+#include "pico/stdlib.h"
+
+/*
+ * A clk_sys cycle model of the parts of the RP2040 that src/probe.c and
+ * src/autobaud.c program: both PIO blocks, the DMA channels and the GPIO
+ * pads. It sits behind the hardware/pio.h and hardware/dma.h stand-ins, so
+ * the real driver code runs on it against the real pioasm output.
+ *
+ * State machines run every instruction, side-set, delay, wrap and the
+ * fractional clock divider as the hardware does, and see their inputs
+ * through the 2-cycle synchroniser. A DMA channel moves one transfer per
+ * cycle while its DREQ allows. The CPU is not modelled: every register
+ * access through the stand-ins lets the model run on by a fixed number of
+ * cycles instead, and busy_wait_us_32() runs it for the time asked.
+ */
+
+// Called every cycle with what the chip drives on the pads (GPIO, SIO and
+// PIO outputs combined), to say what is driven from outside. Pins not
+// driven from either side float to their pulls.
+typedef void (*pio_sim_pins_fn)(void *ctx, uint64_t cycle, uint32_t out, uint32_t oe,
+                                uint32_t *ext_out, uint32_t *ext_oe);
+
+typedef struct {
+    // clk_sys cycles while enabled, and cycles the clock divider let through
+    uint64_t cycles;
+    uint64_t ticks;
+    // Ticks that completed an instruction, and that were spent in a delay
+    uint64_t executed;
+    uint64_t delay;
+    // Ticks stalled on a pull from an empty TX FIFO, a push to a full RX
+    // FIFO, or a wait or irq
+    uint64_t tx_stall;
+    uint64_t rx_stall;
+    uint64_t wait_stall;
+    // Nonblocking pushes lost to a full RX FIFO
+    uint64_t rx_dropped;
+} pio_sim_sm_stats_t;
+
+void pio_sim_attach(pio_sim_pins_fn pins, void *ctx);
+// Cycles the model runs on for each register access by the CPU
+void pio_sim_set_cpu_cycles(uint cycles);
+uint64_t pio_sim_cycles(void);
+void pio_sim_run(uint64_t cycles);
+// Runs until a state machine waits on an empty TX FIFO that no DMA channel
+// is filling, or is disabled, for at most max cycles. Returns the cycles run.
+uint64_t pio_sim_run_until_idle(uint pio, uint sm, uint64_t max);
+
+const pio_sim_sm_stats_t *pio_sim_sm_stats(uint pio, uint sm);
+void pio_sim_clear_stats(void);
+
+#endif
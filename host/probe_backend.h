@@ -0,0 +1,33 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef PROBE_BACKEND_H
+#define PROBE_BACKEND_H
+
+#include "pico/stdlib.h"
+
+/*
+ * What the host build of probe.h drives in place of the PIO state machine.
+ * Bits are LSB first, and each call moves 1..32 of them - probe_host.c
+ * splits longer sequences. Reads return the bits shifted down to the LSBs.
+ * The optional calls may be NULL.
+ */
+typedef struct {
+    void (*write_bits)(void *ctx, uint bit_count, uint32_t data);
+    uint32_t (*read_bits)(void *ctx, uint bit_count);
+    // SWDIO released by the probe
+    void (*hiz_clocks)(void *ctx, uint bit_count);
+    // Optional: SWCLK in use, and nRESET driven low or released
+    void (*set_swclk)(void *ctx, uint32_t freq_hz);
+    void (*set_reset)(void *ctx, bool asserted);
+    void *ctx;
+} probe_backend_t;
+
+// NULL puts back the default, an SWD bus with nothing on it
+void probe_set_backend(const probe_backend_t *backend);
+const probe_backend_t *probe_get_backend(void);
+
+#endif
@@ -0,0 +1,279 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <hardware/clocks.h>
+
+#include "probe_config.h"
+#include "probe.h"
+#include "probe_backend.h"
+#include "DAP.h"
+
+#define DIV_ROUND_UP(m, n)	(((m) + (n) - 1) / (n))
+
+// probe.c's shortest SWCLK period in PIO cycles
+#define PROBE_CYCLES_MIN        4
+
+/*
+ * probe.h for the host build. Stream commands run on the backend as they are
+ * queued, so every result is ready by the time it is asked for. A txn that
+ * gets anything but an OK ACK drops everything queued behind it until
+ * probe_stream_cancel(), as the SM does.
+ */
+static struct {
+    probe_clock_t clock;
+    uint sample_delay;
+    bool initted;
+    bool reset_asserted;
+    bool skipping;
+    uint32_t rx[PROBE_STREAM_READS];
+    uint rx_head;
+} probe = {
+    .sample_delay = PROBE_SAMPLE_DELAY,
+};
+
+// Nothing on the bus: SWDIO stays pulled up
+static void idle_write_bits(void *ctx, uint bit_count, uint32_t data)
+{
+    (void)ctx;
+    (void)bit_count;
+    (void)data;
+}
+
+static uint32_t idle_read_bits(void *ctx, uint bit_count)
+{
+    (void)ctx;
+    return bit_count < 32 ? (1u << bit_count) - 1 : 0xffffffffu;
+}
+
+static void idle_hiz_clocks(void *ctx, uint bit_count)
+{
+    (void)ctx;
+    (void)bit_count;
+}
+
+static const probe_backend_t probe_idle_backend = {
+    .write_bits = idle_write_bits,
+    .read_bits = idle_read_bits,
+    .hiz_clocks = idle_hiz_clocks,
+};
+
+static const probe_backend_t *backend = &probe_idle_backend;
+
+void probe_set_backend(const probe_backend_t *new_backend)
+{
+    backend = new_backend ? new_backend : &probe_idle_backend;
+    if (backend->set_swclk && probe.clock.freq_hz)
+        backend->set_swclk(backend->ctx, probe.clock.freq_hz);
+    if (backend->set_reset)
+        backend->set_reset(backend->ctx, probe.reset_asserted);
+}
+
+const probe_backend_t *probe_get_backend(void)
+{
+    return backend;
+}
+
+// The sample delay, in clk_sys cycles, in whole PIO cycles at clk's divider
+static uint probe_sample_cycles(const probe_clock_t *clk, uint sample)
+{
+    return (sample << 8) / (((uint)clk->div_int << 8) | clk->div_frac);
+}
+
+// The PIO timing is not modelled: SWCLK is the clk_sys period rounded up to
+// a whole number of cycles, at the fewest PIO cycles per bit.
+void probe_plan_swclk(uint32_t freq_hz, probe_clock_t *clk)
+{
+    uint32_t clk_sys_freq = clock_get_hz(clk_sys);
+    uint32_t period = DIV_ROUND_UP(clk_sys_freq, freq_hz ? freq_hz : 1);
+    uint sample;
+
+    if (period < PROBE_CYCLES_MIN)
+        period = PROBE_CYCLES_MIN;
+    if (period > PROBE_CYCLES_MIN * 65535)
+        period = PROBE_CYCLES_MIN * 65535;
+    clk->cycles = PROBE_CYCLES_MIN;
+    clk->div_int = period / PROBE_CYCLES_MIN;
+    clk->div_frac = (period % PROBE_CYCLES_MIN) * (256 / PROBE_CYCLES_MIN);
+    clk->freq_hz = DIV_ROUND_UP(clk_sys_freq, period);
+    sample = probe_sample_cycles(clk, probe.sample_delay);
+    clk->sample_delay = sample < clk->cycles / 2U ? sample : clk->cycles / 2U;
+}
+
+uint32_t probe_set_swclk_freq(uint32_t freq_hz)
+{
+    probe_plan_swclk(freq_hz, &probe.clock);
+    probe.clock.sample_delay = probe_set_sample_delay(probe.sample_delay);
+    if (backend->set_swclk)
+        backend->set_swclk(backend->ctx, probe.clock.freq_hz);
+    return probe.clock.freq_hz;
+}
+
+uint probe_set_sample_delay(uint cycles)
+{
+    probe.sample_delay = cycles;
+    cycles = probe_sample_cycles(&probe.clock, cycles);
+    if (cycles > probe.clock.cycles / 2)
+        cycles = probe.clock.cycles / 2;
+    probe.clock.sample_delay = cycles;
+    return cycles;
+}
+
+const probe_clock_t *probe_get_swclk(void)
+{
+    return &probe.clock;
+}
+
+void probe_assert_reset(bool state)
+{
+    // As the firmware: false drives nRESET low
+    probe.reset_asserted = !state;
+    if (backend->set_reset)
+        backend->set_reset(backend->ctx, probe.reset_asserted);
+}
+
+int probe_reset_level(void)
+{
+    return !probe.reset_asserted;
+}
+
+void probe_write_bits(uint bit_count, uint32_t data_byte)
+{
+    probe_stream_write_bits(bit_count, data_byte);
+}
+
+uint32_t probe_read_bits(uint bit_count)
+{
+    return probe_stream_result(probe_stream_read_bits(bit_count));
+}
+
+void probe_hiz_clocks(uint bit_count)
+{
+    probe_stream_hiz_clocks(bit_count);
+}
+
+void probe_stream_write_bits(uint bit_count, uint32_t data)
+{
+    if (probe.skipping)
+        return;
+    // Bits beyond the first 32 are zeros
+    for (; bit_count; data = 0) {
+        uint n = bit_count < 32 ? bit_count : 32;
+        backend->write_bits(backend->ctx, n, data);
+        bit_count -= n;
+    }
+}
+
+void probe_stream_write_buf(uint bit_count, const uint8_t *data)
+{
+    if (probe.skipping)
+        return;
+    for (uint n = 0; n < DIV_ROUND_UP(bit_count, 8); n += 4) {
+        uint32_t word = 0;
+        for (uint i = 0; i < 4 && n + i < DIV_ROUND_UP(bit_count, 8); i++)
+            word |= (uint32_t)data[n + i] << (8 * i);
+        backend->write_bits(backend->ctx, bit_count - 8 * n < 32 ? bit_count - 8 * n : 32, word);
+    }
+}
+
+void probe_stream_write_parity(uint32_t data)
+{
+    if (probe.skipping)
+        return;
+    backend->write_bits(backend->ctx, 32, data);
+    backend->write_bits(backend->ctx, 1, __builtin_popcount(data) & 0x1);
+}
+
+void probe_stream_hiz_clocks(uint bit_count)
+{
+    if (probe.skipping)
+        return;
+    for (; bit_count; ) {
+        uint n = bit_count < 32 ? bit_count : 32;
+        backend->hiz_clocks(backend->ctx, n);
+        bit_count -= n;
+    }
+}
+
+uint probe_stream_read_bits(uint bit_count)
+{
+    uint index = probe.rx_head;
+
+    // One result per 32 bits, the last one holding what is left
+    for (; bit_count; ) {
+        uint n = bit_count < 32 ? bit_count : 32;
+        probe.rx[probe.rx_head++ % PROBE_STREAM_READS] =
+            probe.skipping ? 0 : backend->read_bits(backend->ctx, n);
+        bit_count -= n;
+    }
+    return index;
+}
+
+void probe_stream_read_buf(uint index, uint bit_count, uint8_t *data)
+{
+    for (uint n = 0; n < DIV_ROUND_UP(bit_count, 8); n += 4) {
+        uint32_t word = probe_stream_result(index++);
+        for (uint i = 0; i < 4 && n + i < DIV_ROUND_UP(bit_count, 8); i++)
+            data[n + i] = (uint8_t)(word >> (8 * i));
+    }
+}
+
+uint probe_stream_txn(uint8_t request)
+{
+    uint index = probe.rx_head++;
+    uint32_t ack = 0;
+
+    if (!probe.skipping) {
+        backend->write_bits(backend->ctx, 8, request);
+        backend->hiz_clocks(backend->ctx, 1);
+        ack = backend->read_bits(backend->ctx, 3);
+        if (ack != DAP_TRANSFER_OK) {
+            // Turnaround, then the data phase is dropped
+            backend->hiz_clocks(backend->ctx, 1);
+            probe.skipping = true;
+        }
+    }
+    probe.rx[index % PROBE_STREAM_READS] = ack;
+    return index;
+}
+
+void probe_stream_run(void)
+{
+}
+
+uint32_t probe_stream_result(uint index)
+{
+    return probe.rx[index % PROBE_STREAM_READS];
+}
+
+void probe_stream_cancel(void)
+{
+    probe.skipping = false;
+}
+
+void probe_read_mode(void)
+{
+}
+
+void probe_write_mode(void)
+{
+}
+
+void probe_init(void)
+{
+    if (!probe.initted) {
+        probe.skipping = false;
+        probe_set_swclk_freq(1000000);
+        probe.initted = true;
+    }
+}
+
+void probe_deinit(void)
+{
+    if (probe.initted) {
+        probe_assert_reset(1);
+        probe.initted = false;
+    }
+}
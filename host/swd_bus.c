@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "probe_config.h"
+#include "swd_bus.h"
+
+void swd_bus_init(struct swd_bus *bus, swd_sim_t *sim)
+{
+	memset(bus, 0, sizeof(*bus));
+	bus->sim = sim;
+	bus->target = -1;
+	bus->target_delay = 2;
+}
+
+void swd_bus_pins(void *ctx, uint64_t cycle, uint32_t out, uint32_t oe,
+		  uint32_t *ext_out, uint32_t *ext_oe)
+{
+	struct swd_bus *bus = ctx;
+	bool clk = (out & oe) & (1u << PROBE_PIN_SWCLK);
+#if defined(PROBE_IO_OEN)
+	bool driving = (oe & ~out) & (1u << PROBE_PIN_SWDIOEN);
+#else
+	bool driving = oe & (1u << PROBE_PIN_SWDIO);
+#endif
+	int host = driving ? (int)((out >> PROBE_PIN_SWDIO) & 1u) : -1;
+	int line;
+
+	if (clk && !bus->clk) {
+		swd_sim_clock(bus->sim, host);
+		bus->edges++;
+		bus->next = swd_sim_swdio(bus->sim);
+		bus->next_at = cycle + bus->target_delay;
+		bus->next_due = true;
+	}
+	bus->clk = clk;
+	if (bus->next_due && cycle >= bus->next_at) {
+		bus->target = bus->next;
+		bus->next_due = false;
+	}
+
+	// SWDIO is pulled up
+	line = host >= 0 ? host : bus->target >= 0 ? bus->target : 1;
+#if defined(PROBE_IO_RAW)
+	(void)line;
+	if (bus->target >= 0) {
+		*ext_oe = 1u << PROBE_PIN_SWDIO;
+		*ext_out = (uint32_t)bus->target << PROBE_PIN_SWDIO;
+	}
+#else
+	// SWDI follows the line through its buffer
+	*ext_oe = 1u << PROBE_PIN_SWDI;
+	*ext_out = (uint32_t)line << PROBE_PIN_SWDI;
+#endif
+}
@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef SWD_BUS_H
+#define SWD_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "swd_sim.h"
+
+// The SWD wires between the probe's pads on the PIO model and the target
+// from swd_sim.h, for pio_sim_attach() with swd_bus_pins. The board's pins
+// come from probe_config.h.
+struct swd_bus {
+	swd_sim_t *sim;
+	// clk_sys cycles from an SWCLK rising edge to the target's new level
+	unsigned int target_delay;
+	bool clk;
+	// Level the target drives, -1 if released, and the one it moves to
+	// target_delay cycles after an edge
+	int target;
+	int next;
+	uint64_t next_at;
+	bool next_due;
+	uint64_t edges;
+};
+
+void swd_bus_init(struct swd_bus *bus, swd_sim_t *sim);
+void swd_bus_pins(void *ctx, uint64_t cycle, uint32_t out, uint32_t oe,
+		  uint32_t *ext_out, uint32_t *ext_oe);
+
+#endif
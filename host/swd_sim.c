@@ -0,0 +1,607 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdlib.h>
+
+#include "swd_sim.h"
+
+#define SWDIO_UNDRIVEN          -1
+
+// A line reset is at least 50 cycles with SWDIO high
+#define LINE_RESET_CYCLES       50
+
+#define ACK_OK                  0x1
+#define ACK_WAIT                0x2
+#define ACK_FAULT               0x4
+#define ACK_NONE                0x7
+
+// DP registers, A[3:2]
+#define DP_DPIDR                0x0     // Read
+#define DP_ABORT                0x0     // Write
+#define DP_CTRL_STAT            0x4     // Bank 0, DLCR in bank 1
+#define DP_SELECT               0x8     // Write
+#define DP_RESEND               0x8     // Read
+#define DP_RDBUFF               0xC
+
+#define ABORT_DAPABORT          (1u << 0)
+#define ABORT_STKCMPCLR         (1u << 1)
+#define ABORT_STKERRCLR         (1u << 2)
+#define ABORT_WDERRCLR          (1u << 3)
+#define ABORT_ORUNERRCLR        (1u << 4)
+
+#define CTRL_ORUNDETECT         (1u << 0)
+#define CTRL_STICKYORUN         (1u << 1)
+#define CTRL_STICKYCMP          (1u << 4)
+#define CTRL_STICKYERR          (1u << 5)
+#define CTRL_WDATAERR           (1u << 7)
+#define CTRL_STICKY             (CTRL_STICKYORUN | CTRL_STICKYCMP | CTRL_STICKYERR | CTRL_WDATAERR)
+// ORUNDETECT, TRNMODE, MASKLANE and the reset and power-up requests
+#define CTRL_WRITABLE           0x54000f0du
+
+// MEM-AP registers, APBANKSEL and A[3:2]
+#define AP_CSW                  0x00
+#define AP_TAR                  0x04
+#define AP_DRW                  0x0c
+#define AP_BD0                  0x10
+#define AP_BD3                  0x1c
+#define AP_CFG                  0xf4
+#define AP_BASE                 0xf8
+#define AP_IDR                  0xfc
+
+#define CSW_SIZE_MASK           0x7u
+#define CSW_ADDRINC_SHIFT       4
+#define CSW_ADDRINC_PACKED      2
+#define CSW_DEVICEEN            (1u << 6)
+#define CSW_TRINPROG            (1u << 7)
+
+// TAR only auto-increments within a 1 KB block
+#define TAR_WRAP                0x3ffu
+
+typedef enum {
+    SIM_LOCKOUT,
+    SIM_IDLE,
+    SIM_REQUEST,
+    SIM_TRN_ACK,
+    SIM_ACK,
+    SIM_RDATA,
+    SIM_TRN_WDATA,
+    SIM_WDATA,
+    SIM_TRN_IDLE,
+} sim_state_t;
+
+struct swd_sim {
+    swd_sim_config_t config;
+    probe_backend_t backend;
+    swd_sim_stats_t stats;
+    uint8_t *mem;
+    uint32_t swclk_hz;
+    bool reset_asserted;
+
+    // Bus state
+    uint64_t now;
+    sim_state_t state;
+    uint bit;
+    uint ones;
+    uint trn;
+    uint8_t request;
+    uint8_t ack;
+    uint32_t data;
+    uint32_t parity;
+    // Data phase after a WAIT or FAULT with ORUNDETECT, ignored
+    bool discard;
+
+    // Only a DPIDR read is answered after a line reset
+    bool need_dpidr;
+
+    // DP
+    uint32_t ctrl_stat;
+    uint32_t dlcr;
+    uint32_t select;
+    uint32_t last_rdata;
+    // Result of the last AP read, returned by the next AP read or RDBUFF
+    uint32_t ap_rdata;
+    // The AP answers WAIT until this cycle
+    uint64_t ap_busy_until;
+
+    // MEM-AP
+    uint32_t csw;
+    uint32_t tar;
+
+    // Injected faults
+    uint32_t inject_waits;
+    uint32_t ap_accesses;
+    uint32_t mem_accesses;
+    uint32_t rdata_phases;
+};
+
+static uint32_t parity32(uint32_t data)
+{
+    return __builtin_popcount(data) & 0x1;
+}
+
+static void line_reset(swd_sim_t *sim)
+{
+    sim->state = SIM_IDLE;
+    sim->need_dpidr = true;
+    sim->stats.line_resets++;
+}
+
+static bool mem_access(swd_sim_t *sim, uint32_t addr, bool write, uint32_t *data)
+{
+    uint32_t size = sim->csw & CSW_SIZE_MASK;
+    uint32_t offset = (addr & ~0x3u) - sim->config.mem_base;
+    uint32_t lanes;
+
+    // Bytes and halfwords use their own lanes of the data word
+    if (((sim->csw >> CSW_ADDRINC_SHIFT) & 0x3) == CSW_ADDRINC_PACKED || size >= 2)
+        lanes = 0xffffffffu;
+    else if (size == 1)
+        lanes = 0xffffu << (8 * (addr & 0x2));
+    else
+        lanes = 0xffu << (8 * (addr & 0x3));
+
+    sim->mem_accesses++;
+    if (addr - sim->config.mem_base >= sim->config.mem_size || offset + 4 > sim->config.mem_size ||
+        (sim->config.fault_every && sim->mem_accesses % sim->config.fault_every == 0)) {
+        sim->ctrl_stat |= CTRL_STICKYERR;
+        sim->stats.bus_errors++;
+        if (!write)
+            *data = 0;
+        return false;
+    }
+
+    uint8_t *p = &sim->mem[offset];
+    uint32_t word = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    if (write) {
+        word = (word & ~lanes) | (*data & lanes);
+        for (uint i = 0; i < 4; i++)
+            p[i] = (uint8_t)(word >> (8 * i));
+    } else {
+        *data = word & lanes;
+    }
+    return true;
+}
+
+static void tar_increment(swd_sim_t *sim)
+{
+    uint32_t addrinc = (sim->csw >> CSW_ADDRINC_SHIFT) & 0x3;
+    uint32_t size = sim->csw & CSW_SIZE_MASK;
+    uint32_t step;
+
+    if (!addrinc)
+        return;
+    step = (addrinc == CSW_ADDRINC_PACKED || size >= 2) ? 4 : 1u << size;
+    sim->tar = (sim->tar & ~TAR_WRAP) | ((sim->tar + step) & TAR_WRAP);
+}
+
+static void ap_access(swd_sim_t *sim, bool write, uint32_t *data)
+{
+    uint reg = (sim->select & 0xf0) | (sim->request >> 1 & 0xc);
+
+    if (write)
+        sim->stats.ap_writes++;
+    else
+        sim->stats.ap_reads++;
+
+    if (sim->select >> 24) {
+        // Nothing at other APSELs
+        if (!write)
+            *data = 0;
+        return;
+    }
+
+    if (reg == AP_DRW || (reg >= AP_BD0 && reg <= AP_BD3)) {
+        uint32_t addr = reg == AP_DRW ? sim->tar : (sim->tar & ~0xfu) | (reg & 0xc);
+        mem_access(sim, addr, write, data);
+        if (reg == AP_DRW)
+            tar_increment(sim);
+        sim->ap_busy_until = sim->now + sim->config.mem_latency;
+        return;
+    }
+
+    if (write) {
+        if (reg == AP_CSW)
+            sim->csw = *data & ~(CSW_DEVICEEN | CSW_TRINPROG);
+        else if (reg == AP_TAR)
+            sim->tar = *data;
+        return;
+    }
+
+    switch (reg) {
+    case AP_CSW:
+        *data = sim->csw | CSW_DEVICEEN;
+        break;
+    case AP_TAR:
+        *data = sim->tar;
+        break;
+    case AP_BASE:
+        *data = sim->config.ap_base;
+        break;
+    case AP_IDR:
+        *data = sim->config.ap_idr;
+        break;
+    case AP_CFG:
+    default:
+        *data = 0;
+        break;
+    }
+}
+
+static uint8_t transfer_ack(swd_sim_t *sim, bool apndp, bool rnw, uint addr)
+{
+    // Always answered, whatever else is going on
+    if (!apndp && ((rnw && (addr == DP_DPIDR || addr == DP_CTRL_STAT)) || (!rnw && addr == DP_ABORT)))
+        return ACK_OK;
+    if (sim->ctrl_stat & CTRL_STICKY)
+        return ACK_FAULT;
+    if (apndp || (rnw && addr == DP_RDBUFF)) {
+        if (sim->now < sim->ap_busy_until)
+            return ACK_WAIT;
+        if (sim->inject_waits) {
+            sim->inject_waits--;
+            return ACK_WAIT;
+        }
+    }
+    return ACK_OK;
+}
+
+static uint32_t dp_read(swd_sim_t *sim, uint addr)
+{
+    switch (addr) {
+    case DP_DPIDR:
+        sim->need_dpidr = false;
+        return sim->config.dpidr;
+    case DP_CTRL_STAT:
+        if ((sim->select & 0xf) == 1)
+            return sim->dlcr;
+        if (sim->select & 0xf)
+            return 0;
+        // Power-up and reset requests are acknowledged at once
+        return sim->ctrl_stat | ((sim->ctrl_stat & 0x54000000u) << 1);
+    case DP_RESEND:
+        return sim->last_rdata;
+    case DP_RDBUFF:
+    default:
+        return sim->ap_rdata;
+    }
+}
+
+static void dp_write(swd_sim_t *sim, uint addr, uint32_t data)
+{
+    switch (addr) {
+    case DP_ABORT:
+        if (data & ABORT_DAPABORT) {
+            sim->ap_busy_until = 0;
+            sim->inject_waits = 0;
+        }
+        if (data & ABORT_STKCMPCLR)
+            sim->ctrl_stat &= ~CTRL_STICKYCMP;
+        if (data & ABORT_STKERRCLR)
+            sim->ctrl_stat &= ~CTRL_STICKYERR;
+        if (data & ABORT_WDERRCLR)
+            sim->ctrl_stat &= ~CTRL_WDATAERR;
+        if (data & ABORT_ORUNERRCLR)
+            sim->ctrl_stat &= ~CTRL_STICKYORUN;
+        break;
+    case DP_CTRL_STAT:
+        if ((sim->select & 0xf) == 0) {
+            sim->ctrl_stat = (sim->ctrl_stat & CTRL_STICKY) | (data & CTRL_WRITABLE);
+        } else if ((sim->select & 0xf) == 1) {
+            sim->dlcr = data & 0x300;
+            sim->trn = ((sim->dlcr >> 8) & 0x3) + 1;
+        }
+        break;
+    case DP_SELECT:
+        sim->select = data;
+        break;
+    default:
+        // TARGETSEL is only for multidrop
+        break;
+    }
+}
+
+// Request received: work out the ACK, and for reads the data to return
+static void request_done(swd_sim_t *sim)
+{
+    uint8_t req = sim->request;
+    bool apndp = req >> 1 & 0x1;
+    bool rnw = req >> 2 & 0x1;
+    uint addr = req >> 1 & 0xc;
+
+    if (!(req & 0x1) || (req >> 6 & 0x1) || !(req >> 7 & 0x1) ||
+        parity32(req >> 1 & 0xf) != (req >> 5 & 0x1u)) {
+        sim->stats.protocol_errors++;
+        sim->state = SIM_LOCKOUT;
+        return;
+    }
+    sim->stats.requests++;
+    if (sim->need_dpidr && (apndp || !rnw || addr != DP_DPIDR)) {
+        sim->stats.no_response++;
+        sim->state = SIM_LOCKOUT;
+        return;
+    }
+
+    sim->ack = transfer_ack(sim, apndp, rnw, addr);
+    if (sim->ack == ACK_OK) {
+        sim->stats.acks_ok++;
+        if (apndp && sim->config.wait_every && ++sim->ap_accesses % sim->config.wait_every == 0)
+            sim->inject_waits = sim->config.wait_burst;
+        if (rnw) {
+            if (apndp) {
+                // Posted: this returns the previous read's result
+                sim->data = sim->ap_rdata;
+                ap_access(sim, false, &sim->ap_rdata);
+            } else {
+                sim->data = dp_read(sim, addr);
+            }
+            if (addr != DP_RESEND || apndp)
+                sim->last_rdata = sim->data;
+            sim->parity = parity32(sim->data);
+            if (sim->config.parity_error_every &&
+                ++sim->rdata_phases % sim->config.parity_error_every == 0)
+                sim->parity ^= 1;
+        }
+    } else if (sim->ack == ACK_WAIT) {
+        sim->stats.acks_wait++;
+    } else {
+        sim->stats.acks_fault++;
+    }
+    // An overrun: the probe still clocks the data phase
+    sim->discard = sim->ack != ACK_OK && (sim->ctrl_stat & CTRL_ORUNDETECT);
+    if (sim->discard)
+        sim->ctrl_stat |= CTRL_STICKYORUN;
+    sim->state = SIM_TRN_ACK;
+    sim->bit = 0;
+}
+
+static void wdata_done(swd_sim_t *sim)
+{
+    if (parity32(sim->data) != sim->parity) {
+        sim->ctrl_stat |= CTRL_WDATAERR;
+        sim->stats.wdata_errors++;
+        return;
+    }
+    if (sim->request >> 1 & 0x1)
+        ap_access(sim, true, &sim->data);
+    else
+        dp_write(sim, sim->request >> 1 & 0xc, sim->data);
+}
+
+// The level the target drives on SWDIO until the next rising edge
+static int sim_drive(const swd_sim_t *sim)
+{
+    if (sim->ones >= LINE_RESET_CYCLES)
+        return SWDIO_UNDRIVEN;
+    if (sim->state == SIM_ACK)
+        return sim->ack >> sim->bit & 0x1;
+    if (sim->state == SIM_RDATA && !sim->discard)
+        return sim->bit < 32 ? sim->data >> sim->bit & 0x1 : sim->parity;
+    return SWDIO_UNDRIVEN;
+}
+
+// One SWCLK cycle. host is the level the probe drives, or SWDIO_UNDRIVEN;
+// returns the level on SWDIO, pulled up when nobody drives it.
+static int sim_clock(swd_sim_t *sim, int host)
+{
+    int target = sim_drive(sim);
+    int level;
+
+    sim->now++;
+    sim->stats.cycles++;
+    if (host == 1) {
+        if (++sim->ones == LINE_RESET_CYCLES)
+            line_reset(sim);
+    } else if (host == 0) {
+        sim->ones = 0;
+    }
+    // Held in reset for as long as the line stays high
+    if (sim->ones >= LINE_RESET_CYCLES)
+        return host;
+
+    switch (sim->state) {
+    case SIM_LOCKOUT:
+        break;
+    case SIM_IDLE:
+        if (host == 1) {
+            sim->request = 0x1;
+            sim->bit = 1;
+            sim->state = SIM_REQUEST;
+        }
+        break;
+    case SIM_REQUEST:
+        sim->request |= (host != 0) << sim->bit;
+        if (++sim->bit == 8)
+            request_done(sim);
+        break;
+    case SIM_TRN_ACK:
+        if (++sim->bit == sim->trn) {
+            sim->state = SIM_ACK;
+            sim->bit = 0;
+        }
+        break;
+    case SIM_ACK:
+        if (++sim->bit == 3) {
+            sim->bit = 0;
+            if (sim->ack != ACK_OK && !sim->discard)
+                sim->state = SIM_TRN_IDLE;
+            else if (sim->request >> 2 & 0x1)
+                sim->state = SIM_RDATA;
+            else
+                sim->state = SIM_TRN_WDATA;
+        }
+        break;
+    case SIM_RDATA:
+        if (++sim->bit == 33) {
+            sim->bit = 0;
+            sim->state = SIM_TRN_IDLE;
+        }
+        break;
+    case SIM_TRN_WDATA:
+        if (++sim->bit == sim->trn) {
+            sim->bit = 0;
+            sim->data = 0;
+            sim->state = SIM_WDATA;
+        }
+        break;
+    case SIM_WDATA:
+        if (host == SWDIO_UNDRIVEN)
+            sim->stats.undriven++;
+        if (sim->bit < 32)
+            sim->data |= (uint32_t)(host != 0) << sim->bit;
+        else
+            sim->parity = host != 0;
+        if (++sim->bit == 33) {
+            if (!sim->discard)
+                wdata_done(sim);
+            sim->state = SIM_IDLE;
+        }
+        break;
+    case SIM_TRN_IDLE:
+        if (++sim->bit == sim->trn)
+            sim->state = SIM_IDLE;
+        break;
+    }
+
+    if (target != SWDIO_UNDRIVEN && host != SWDIO_UNDRIVEN)
+        sim->stats.contention++;
+    level = target != SWDIO_UNDRIVEN ? target : host;
+    return level != SWDIO_UNDRIVEN ? level : 1;
+}
+
+int swd_sim_swdio(const swd_sim_t *sim)
+{
+    return sim_drive(sim);
+}
+
+int swd_sim_clock(swd_sim_t *sim, int swdio)
+{
+    return sim_clock(sim, swdio);
+}
+
+static void sim_write_bits(void *ctx, uint bit_count, uint32_t data)
+{
+    for (uint i = 0; i < bit_count; i++)
+        sim_clock(ctx, data >> i & 0x1);
+}
+
+static uint32_t sim_read_bits(void *ctx, uint bit_count)
+{
+    uint32_t data = 0;
+
+    for (uint i = 0; i < bit_count; i++)
+        data |= (uint32_t)sim_clock(ctx, SWDIO_UNDRIVEN) << i;
+    return data;
+}
+
+static void sim_hiz_clocks(void *ctx, uint bit_count)
+{
+    for (uint i = 0; i < bit_count; i++)
+        sim_clock(ctx, SWDIO_UNDRIVEN);
+}
+
+static void sim_set_swclk(void *ctx, uint32_t freq_hz)
+{
+    swd_sim_t *sim = ctx;
+
+    sim->swclk_hz = freq_hz;
+}
+
+static void sim_set_reset(void *ctx, bool asserted)
+{
+    swd_sim_t *sim = ctx;
+
+    // nRESET leaves the debug logic alone
+    sim->reset_asserted = asserted;
+}
+
+void swd_sim_default_config(swd_sim_config_t *config)
+{
+    *config = (swd_sim_config_t) {
+        .dpidr = 0x2ba01477,            // SW-DP, DPv1
+        .ap_idr = 0x24770011,           // AHB-AP
+        .ap_base = 0xe00ff003,
+        .mem_base = 0x20000000,
+        .mem_size = 256 * 1024,
+    };
+}
+
+swd_sim_t *swd_sim_create(const swd_sim_config_t *config)
+{
+    swd_sim_t *sim = calloc(1, sizeof(*sim));
+
+    if (!sim)
+        return NULL;
+    sim->config = *config;
+    sim->config.mem_size &= ~0x3u;
+    sim->mem = calloc(1, sim->config.mem_size ? sim->config.mem_size : 1);
+    if (!sim->mem) {
+        free(sim);
+        return NULL;
+    }
+    sim->backend = (probe_backend_t) {
+        .write_bits = sim_write_bits,
+        .read_bits = sim_read_bits,
+        .hiz_clocks = sim_hiz_clocks,
+        .set_swclk = sim_set_swclk,
+        .set_reset = sim_set_reset,
+        .ctx = sim,
+    };
+    swd_sim_reset(sim);
+    return sim;
+}
+
+void swd_sim_destroy(swd_sim_t *sim)
+{
+    if (sim) {
+        free(sim->mem);
+        free(sim);
+    }
+}
+
+void swd_sim_reset(swd_sim_t *sim)
+{
+    sim->state = SIM_LOCKOUT;
+    sim->ones = 0;
+    sim->trn = 1;
+    sim->need_dpidr = true;
+    sim->ctrl_stat = 0;
+    sim->dlcr = 0;
+    sim->select = 0;
+    sim->last_rdata = 0;
+    sim->ap_rdata = 0;
+    sim->ap_busy_until = 0;
+    sim->csw = 0x2;
+    sim->tar = 0;
+    sim->inject_waits = 0;
+    sim->ap_accesses = 0;
+    sim->mem_accesses = 0;
+    sim->rdata_phases = 0;
+}
+
+const probe_backend_t *swd_sim_backend(swd_sim_t *sim)
+{
+    return &sim->backend;
+}
+
+uint8_t *swd_sim_memory(swd_sim_t *sim)
+{
+    return sim->mem;
+}
+
+uint32_t swd_sim_swclk(const swd_sim_t *sim)
+{
+    return sim->swclk_hz;
+}
+
+const swd_sim_stats_t *swd_sim_get_stats(const swd_sim_t *sim)
+{
+    return &sim->stats;
+}
+
+void swd_sim_clear_stats(swd_sim_t *sim)
+{
+    sim->stats = (swd_sim_stats_t) { 0 };
+}
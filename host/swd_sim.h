@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef SWD_SIM_H
+#define SWD_SIM_H
+
+#include "probe_backend.h"
+
+/*
+ * A simulated ADIv5 SWD target, clocked bit by bit from the probe_backend_t
+ * it provides. The DP has DPIDR, ABORT, CTRL/STAT, DLCR, SELECT, RESEND and
+ * RDBUFF. APSEL 0 is a MEM-AP over one window of RAM, with CSW, TAR (auto-
+ * increment wraps within 1 KB), DRW, BD0-3, CFG, BASE and IDR; other APs
+ * read as zero. AP reads are posted.
+ *
+ * As a real target it starts locked out until a line reset, answers nothing
+ * but a DPIDR read after one, and stops responding on a protocol error.
+ * A memory access keeps the AP busy for mem_latency SWCLK cycles, answering
+ * WAIT meanwhile. The _every settings inject faults every Nth event, 0 for
+ * never: a run of wait_burst WAITs after an AP access, a bus error
+ * (STICKYERR, then FAULT) on a memory access, or a bad parity bit on read
+ * data. With ORUNDETECT set, a WAIT or FAULT sets STICKYORUN and still
+ * takes its data phase.
+ */
+typedef struct {
+    uint32_t dpidr;
+    uint32_t ap_idr;
+    uint32_t ap_base;
+    uint32_t mem_base;
+    uint32_t mem_size;
+    uint32_t mem_latency;
+    uint32_t wait_every;
+    uint32_t wait_burst;
+    uint32_t fault_every;
+    uint32_t parity_error_every;
+} swd_sim_config_t;
+
+typedef struct {
+    uint64_t cycles;
+    uint32_t requests;
+    uint32_t acks_ok;
+    uint32_t acks_wait;
+    uint32_t acks_fault;
+    // Requests left unanswered: locked out, or no DPIDR read after reset
+    uint32_t no_response;
+    // Bad start, stop, park or parity bit in a request
+    uint32_t protocol_errors;
+    uint32_t line_resets;
+    // Bad parity on write data
+    uint32_t wdata_errors;
+    // Probe and target driving SWDIO in the same cycle, or neither of them
+    // when the target expects data
+    uint32_t contention;
+    uint32_t undriven;
+    uint32_t ap_reads;
+    uint32_t ap_writes;
+    uint32_t bus_errors;
+} swd_sim_stats_t;
+
+typedef struct swd_sim swd_sim_t;
+
+void swd_sim_default_config(swd_sim_config_t *config);
+swd_sim_t *swd_sim_create(const swd_sim_config_t *config);
+void swd_sim_destroy(swd_sim_t *sim);
+// Power-on reset of the debug logic. Memory is kept.
+void swd_sim_reset(swd_sim_t *sim);
+
+const probe_backend_t *swd_sim_backend(swd_sim_t *sim);
+// Edge-level access, for a probe model that drives SWCLK itself. The level
+// the target puts on SWDIO until the next rising edge, -1 if released, and
+// a rising edge with the probe's level on SWDIO, -1 if released. The edge
+// returns the level on the line in the cycle it ends.
+int swd_sim_swdio(const swd_sim_t *sim);
+int swd_sim_clock(swd_sim_t *sim, int swdio);
+// The RAM window, mem_size bytes from mem_base
+uint8_t *swd_sim_memory(swd_sim_t *sim);
+// SWCLK as last set by the probe, 0 if never
+uint32_t swd_sim_swclk(const swd_sim_t *sim);
+
+const swd_sim_stats_t *swd_sim_get_stats(const swd_sim_t *sim);
+void swd_sim_clear_stats(swd_sim_t *sim);
+
+#endif
@@ -50,6 +50,7 @@ This information includes:
 #include "cmsis_compiler.h"
 #include "probe_config.h"
 #include "probe.h"
+#include "sw_dp_pio.h"
 
 /// Processor Clock of the Cortex-M MCU used in the Debug Unit.
 /// This value is used to calculate the SWD/JTAG clock speed.
@@ -90,17 +91,63 @@ This information includes:
 /// This configuration settings is used to optimize the communication performance with the
 /// debugger and depends on the USB peripheral. Typical vales are 64 for Full-speed USB HID or WinUSB,
 /// 1024 for High-speed USB HID and 512 for High-speed USB WinUSB.
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V2)
+#define DAP_PACKET_SIZE         PROBE_DAP_PACKET_SIZE ///< Specifies Packet Size in bytes.
+#else
 #define DAP_PACKET_SIZE         64U            ///< Specifies Packet Size in bytes.
+#endif
 
 /// Maximum Package Buffers for Command and Response data.
 /// This configuration settings is used to optimize the communication performance with the
 /// debugger and depends on the USB peripheral. For devices with limited RAM or USB buffer the
 /// setting can be reduced (valid range is 1 .. 255).
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V2) && ((PROBE_DAP_RING_SIZE / (2U * 64U)) > 255U)
+#define DAP_PACKET_COUNT        255U            ///< Specifies number of packets buffered.
+#elif (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V2)
+#define DAP_PACKET_COUNT        (PROBE_DAP_RING_SIZE / (2U * 64U)) ///< Specifies number of packets buffered.
+#else
 #define DAP_PACKET_COUNT        8U              ///< Specifies number of packets buffered.
+#endif
+
+/// Packet size and count in use, reported by DAP_Info. On the bulk interface
+/// DAP_PACKET_SIZE and DAP_PACKET_COUNT are only the largest allowed, the ring
+/// layout being set by ID_DAP_Probe_PacketConfig.
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V2)
+uint16_t dap_edpt_packet_size(void);
+uint8_t dap_edpt_packet_count(void);
+// Layout for the next USB reset, see tusb_edpt_handler.c
+bool dap_edpt_set_layout(uint8_t count, uint16_t size);
+void dap_edpt_get_layout(uint8_t *count, uint16_t *size);
+#define DAP_PACKET_SIZE_ACTIVE  dap_edpt_packet_size()
+#define DAP_PACKET_COUNT_ACTIVE dap_edpt_packet_count()
+#else
+#define DAP_PACKET_SIZE_ACTIVE  DAP_PACKET_SIZE
+#define DAP_PACKET_COUNT_ACTIVE DAP_PACKET_COUNT
+#endif
+
+/// Activity counters for ID_DAP_Probe_Stats, kept by usb_thread and dap_thread.
+/// Latency is from a request arriving to its response being queued for USB.
+/// The byte counts over the time since start_us give the sustained throughput.
+typedef struct {
+  uint32_t usb_wakeups;
+  uint32_t dap_wakeups;
+  uint32_t commands;
+  uint32_t latency_total_us;
+  uint32_t latency_max_us;
+  uint32_t bytes_out;
+  uint32_t bytes_in;
+  uint32_t start_us;
+} dap_stats_t;
+extern dap_stats_t dap_stats;
 
 /// Indicate that UART Serial Wire Output (SWO) trace is available.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
+/* Received by a PIO UART on boards with a PROBE_SWO_PIN, see swo.c */
+#ifdef PROBE_SWO_PIN
+#define SWO_UART                1               ///< SWO UART:  1 = available, 0 = not available.
+#else
 #define SWO_UART                0               ///< SWO UART:  1 = available, 0 = not available.
+#endif
 
 /// USART Driver instance number for the UART SWO.
 #define SWO_UART_DRIVER         0               ///< USART Driver instance number (Driver_USART#).
@@ -116,7 +163,12 @@ This information includes:
 #define SWO_BUFFER_SIZE         4096U           ///< SWO Trace Buffer Size in bytes (must be 2^n).
 
 /// SWO Streaming Trace.
+/* On its own bulk IN endpoint of the v2 interface, see tusb_edpt_handler.c */
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V2) && (SWO_UART != 0)
+#define SWO_STREAM              1               ///< SWO Streaming Trace: 1 = available, 0 = not available.
+#else
 #define SWO_STREAM              0               ///< SWO Streaming Trace: 1 = available, 0 = not available.
+#endif
 
 /// Clock frequency of the Test Domain Timer. Timer value is returned with \ref TIMESTAMP_GET.
 #define TIMESTAMP_CLOCK         1000000U      ///< Timestamp clock in Hz (0 = timestamps not supported).
@@ -317,10 +369,11 @@ Configures the DAP Hardware I/O pins for Serial Wire Debug (SWD) mode:
  - TDI, nTRST to HighZ mode (pins are unused in SWD mode).
 */
 // hack - zap our "stop doing divides everywhere" cache
-extern volatile uint32_t cached_delay;
+extern volatile uint32_t cached_clock;
 __STATIC_INLINE void PORT_SWD_SETUP (void) {
   probe_init();
-  cached_delay = 0;
+  cached_clock = 0;
+  SWD_CalibrateOnConnect();
 }
 
 /** Disable JTAG/SWD I/O Pins.
@@ -37,6 +37,8 @@
 // For level-shifted input.
 #define PROBE_PIN_SWDI (PROBE_PIN_OFFSET + 1)
 #define PROBE_PIN_SWDIO (PROBE_PIN_OFFSET + 2)
+// SWDI comes back through the input buffer, sample one clk_sys cycle late
+#define PROBE_SAMPLE_DELAY 1
 
 // UART config
 #define PROBE_UART_TX 4
@@ -67,6 +67,10 @@
 #define PROBE_PIN_SWDI (PROBE_PIN_OFFSET + 3)
 #endif
 
+/* SWDIO sample point in clk_sys cycles after the SWCLK rising edge, to allow for the round
+ * trip through level shifters and cables. Omit to sample on the edge. */
+#define PROBE_SAMPLE_DELAY 1
+
 #if defined(PROBE_CDC_UART)
 #define PROBE_UART_TX 4
 #define PROBE_UART_RX 5
@@ -85,6 +89,9 @@
 
 #endif
 
+/* SWO trace input, received as UART (NRZ) by a state machine on pio1. Omit if not used. */
+#define PROBE_SWO_PIN 11
+
 /* LED config - some or all of these can be omitted if not used */
 #define PROBE_USB_CONNECTED_LED 2
 #define PROBE_DAP_CONNECTED_LED 15
@@ -34,6 +34,8 @@
 #define PROBE_PIN_OFFSET 2
 #define PROBE_PIN_SWCLK (PROBE_PIN_OFFSET + 0) // 2
 #define PROBE_PIN_SWDIO (PROBE_PIN_OFFSET + 1) // 3
+// SWDIO is wired straight to the GPIO, sample on the rising edge
+#define PROBE_SAMPLE_DELAY 0
 // Target reset config
 #define PROBE_PIN_RESET 1
 
@@ -43,6 +45,9 @@
 #define PROBE_UART_INTERFACE uart1
 #define PROBE_UART_BAUDRATE 115200
 
+// SWO trace input (UART encoding)
+#define PROBE_SWO_PIN 6
+
 #define PROBE_USB_CONNECTED_LED 25
 
 #define PROBE_PRODUCT_STRING "Debugprobe on Pico (CMSIS-DAP)"
@@ -309,7 +309,8 @@ void autobaud_deinit() {
 }
 
 bool autobaud_init() {
-    pio = pio0;
+    // The probe program takes up most of pio0's instruction memory
+    pio = pio1;
     // Claim a free PIO state machine
     sm = pio_claim_unused_sm(pio, true);
     if (sm < 0)
@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <assert.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "dap_queue.h"
+
+/*
+ * Held responses, each a u16 length and the response. Should a batch outgrow
+ * this space, the responses held so far are released early rather than stall
+ * the batch.
+ */
+static uint8_t held_buf[PROBE_DAP_QUEUE_SIZE] __attribute__((aligned(4)));
+static uint32_t held_len;
+static_assert(PROBE_DAP_QUEUE_SIZE >= 2 + DAP_PACKET_SIZE, "DAP queue smaller than a packet");
+
+void dap_queue_hold(uint8_t *request, uint16_t packet_size, dap_queue_emit_fn emit, void *ctx)
+{
+	uint16_t resp_len;
+
+	if (held_len + 2 + packet_size > sizeof(held_buf))
+		dap_queue_release(emit, ctx);
+	*request = ID_DAP_ExecuteCommands;
+	resp_len = DAP_ExecuteCommand(request, &held_buf[held_len + 2]) & 0xffff;
+	held_buf[held_len] = resp_len & 0xff;
+	held_buf[held_len + 1] = resp_len >> 8;
+	held_len += 2 + resp_len;
+}
+
+void dap_queue_release(dap_queue_emit_fn emit, void *ctx)
+{
+	uint32_t n = 0;
+	uint16_t len;
+
+	while (n < held_len)
+	{
+		len = held_buf[n] | (held_buf[n + 1] << 8);
+		emit(ctx, &held_buf[n + 2], len);
+		n += 2 + len;
+	}
+	held_len = 0;
+}
+
+void dap_queue_drop(void)
+{
+	held_len = 0;
+}
+
+bool dap_queue_held(void)
+{
+	return held_len != 0;
+}
@@ -0,0 +1,32 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef DAP_QUEUE_H
+#define DAP_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * DAP_QueueCommands batches, shared by dap_thread and the host build. The
+ * commands in a batch run as they arrive, but their responses are held until
+ * a request of any other kind closes the batch.
+ */
+
+// Called for every response released, oldest first
+typedef void (*dap_queue_emit_fn)(void *ctx, const uint8_t *response, uint32_t len);
+
+// Run a DAP_QueueCommands request, rewritten in place as DAP_ExecuteCommands,
+// and hold its response. If a response to a packet_size request might not fit
+// behind those already held, they are released first.
+void dap_queue_hold(uint8_t *request, uint16_t packet_size, dap_queue_emit_fn emit, void *ctx);
+// Release every held response and close the batch
+void dap_queue_release(dap_queue_emit_fn emit, void *ctx);
+// Forget the held responses, for a host that has gone
+void dap_queue_drop(void);
+bool dap_queue_held(void);
+
+#endif
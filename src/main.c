@@ -45,14 +45,12 @@
 #include "get_serial.h"
 #include "tusb_edpt_handler.h"
 #include "DAP.h"
+#include "swo.h"
 #include "hardware/structs/usb.h"
 
 // UART0 for debugprobe debug
 // UART1 for debugprobe to target device
 
-static uint8_t TxDataBuffer[CFG_TUD_HID_EP_BUFSIZE];
-static uint8_t RxDataBuffer[CFG_TUD_HID_EP_BUFSIZE];
-
 #define THREADED 1
 
 #define UART_TASK_PRIO (tskIDLE_PRIORITY + 3)
@@ -60,8 +58,12 @@ static uint8_t RxDataBuffer[CFG_TUD_HID_EP_BUFSIZE];
 #define DAP_TASK_PRIO  (tskIDLE_PRIORITY + 1)
 
 #define AUTOBAUD_TASK_PRIO  (tskIDLE_PRIORITY + 1)
+#define SWO_TASK_PRIO  (tskIDLE_PRIORITY + 1)
 
 TaskHandle_t dap_taskhandle, tud_taskhandle, mon_taskhandle;
+#if (SWO_STREAM != 0)
+osThreadId_t SWO_ThreadId;
+#endif
 
 static int was_configured;
 
@@ -132,18 +134,15 @@ void usb_thread(void *ptr)
         // If suspended or disconnected, unconditional delay for 1ms (20 ticks)
         if (tud_suspended() || !tud_connected())
             xTaskDelayUntil(&wake, 20);
-        // Go to sleep if nothing to do
+        // Go to sleep if nothing to do. tud_event_hook_cb() notifies us of every event queued,
+        // deferred calls from dap_thread included, so there is no need to poll.
         else if (!tud_task_event_ready())
-          xTaskNotifyWait(0, 0xFFFFFFFFu, &cmd, 1);
+          xTaskNotifyWait(0, 0xFFFFFFFFu, &cmd, portMAX_DELAY);
+        dap_stats.usb_wakeups++;
 
     } while (1);
 }
 
-// Workaround API change in 0.13
-#if (TUSB_VERSION_MAJOR == 0) && (TUSB_VERSION_MINOR <= 12)
-#define tud_vendor_flush(x) ((void)0)
-#endif
-
 int main(void) {
     // Declare pins in binary information
     bi_decl_config();
@@ -175,15 +174,6 @@ int main(void) {
     while (!THREADED) {
         tud_task();
         cdc_task();
-
-#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V2)
-        if (tud_vendor_available()) {
-            uint32_t resp_len;
-            tud_vendor_read(RxDataBuffer, sizeof(RxDataBuffer));
-            resp_len = DAP_ProcessCommand(RxDataBuffer, TxDataBuffer);
-            tud_vendor_write(TxDataBuffer, resp_len);
-        }
-#endif
     }
 
     return 0;
@@ -203,16 +193,26 @@ uint16_t tud_hid_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t
 
 void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t const* RxDataBuffer, uint16_t bufsize)
 {
-  uint32_t response_size = TU_MIN(CFG_TUD_HID_EP_BUFSIZE, bufsize);
-
   // This doesn't use multiple report and report ID
   (void) itf;
   (void) report_id;
   (void) report_type;
 
-  DAP_ProcessCommand(RxDataBuffer, TxDataBuffer);
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V1)
+  // Queued for dap_thread, the response going out from tud_hid_report_complete_cb()
+  dap_hid_report_received(RxDataBuffer, bufsize);
+#endif
+}
 
-  tud_hid_report(0, TxDataBuffer, response_size);
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len)
+{
+  (void) instance;
+  (void) report;
+  (void) len;
+
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V1)
+  dap_hid_report_sent();
+#endif
 }
 
 #if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V2)
@@ -259,6 +259,9 @@ void tud_suspend_cb(bool remote_wakeup_en)
   if (was_configured) {
 	  vTaskSuspend(uart_taskhandle);
 	  vTaskSuspend(dap_taskhandle);
+#if (SWO_STREAM != 0)
+    vTaskSuspend(SWO_ThreadId);
+#endif
     if (autobaud_running)
       autobaud_wait_stop();
     vTaskSuspend(autobaud_taskhandle);
@@ -272,6 +275,9 @@ void tud_resume_cb(void)
   if (was_configured) {
     vTaskResume(uart_taskhandle);
     vTaskResume(dap_taskhandle);
+#if (SWO_STREAM != 0)
+    vTaskResume(SWO_ThreadId);
+#endif
     vTaskResume(autobaud_taskhandle);
   }
 }
@@ -283,6 +289,14 @@ void tud_unmount_cb(void)
   vTaskSuspend(dap_taskhandle);
   vTaskDelete(uart_taskhandle);
   vTaskDelete(dap_taskhandle);
+#if (SWO_STREAM != 0)
+  {
+    /* Trace may still be arriving - stop it waking the thread first */
+    TaskHandle_t swo_taskhandle = SWO_ThreadId;
+    SWO_ThreadId = NULL;
+    vTaskDelete(swo_taskhandle);
+  }
+#endif
   if (autobaud_running)
     autobaud_wait_stop();
   vTaskSuspend(autobaud_taskhandle);
@@ -300,10 +314,17 @@ void tud_mount_cb(void)
     xTaskCreate(dap_thread, "DAP", configMINIMAL_STACK_SIZE, NULL, DAP_TASK_PRIO, &dap_taskhandle);
     /* Autobaud detection using PIO as a frequency counter */
     xTaskCreate(autobaud_thread, "ABR", configMINIMAL_STACK_SIZE, NULL, AUTOBAUD_TASK_PRIO, &autobaud_taskhandle);
+#if (SWO_STREAM != 0)
+    /* Streams SWO trace to its own endpoint */
+    xTaskCreate(SWO_Thread, "SWO", configMINIMAL_STACK_SIZE, NULL, SWO_TASK_PRIO, &SWO_ThreadId);
+#endif
 #if(configNUMBER_OF_CORES > 1)
     vTaskCoreAffinitySet(autobaud_taskhandle, (1 << 1));
     vTaskCoreAffinitySet(dap_taskhandle, (1 << 1));
     vTaskCoreAffinitySet(uart_taskhandle, (1 << 0));
+#if (SWO_STREAM != 0)
+    vTaskCoreAffinitySet(SWO_ThreadId, (1 << 1));
+#endif
 #endif
     was_configured = 1;
   }
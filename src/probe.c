@@ -28,10 +28,17 @@
 #include <string.h>
 
 #include <hardware/clocks.h>
+#include <hardware/dma.h>
 #include <hardware/gpio.h>
 
 #include "probe_config.h"
 #include "probe.h"
+#if defined(PROBE_IO_RAW) || defined(PROBE_IO_SWDI)
+#include "probe.pio.h"
+#endif
+#if defined(PROBE_IO_OEN)
+#include "probe_oen.pio.h"
+#endif
 #include "tusb.h"
 
 #define DIV_ROUND_UP(m, n)	(((m) + (n) - 1) / (n))
@@ -54,21 +61,217 @@ struct _probe {
     // PIO offset
     uint offset;
     uint initted;
+    // DMA channels feeding the TX FIFO and draining the RX FIFO
+    uint tx_dma;
+    uint rx_dma;
+    // SWCLK as currently programmed
+    probe_clock_t clock;
+    // Requested SWDIO sample delay, clk_sys cycles after the rising edge
+    uint sample_delay;
+    // Entry point of reads, which depends on the sample delay
+    uint read_cmd;
+};
+
+static struct _probe probe = {
+    .sample_delay = PROBE_SAMPLE_DELAY,
 };
 
-static struct _probe probe;
+static inline void probe_stream_sync(void);
+static void probe_wait_idle(void);
+
+// Command stream: FIFO words are queued in a ring in RAM and handed to the SM
+// by DMA, read results are collected into a second ring by a free-running
+// channel. Counts are free-running, ring positions are counts modulo size.
+static uint32_t stream_tx[PROBE_STREAM_WORDS] __attribute__((aligned(sizeof(uint32_t) * PROBE_STREAM_WORDS)));
+static uint32_t stream_rx[PROBE_STREAM_READS] __attribute__((aligned(sizeof(uint32_t) * PROBE_STREAM_READS)));
+static struct {
+    uint8_t rx_bits[PROBE_STREAM_READS];
+    // Words queued, and handed to the TX channel
+    uint tx_head;
+    uint tx_sent;
+    // Results queued, and results in when the RX channel was last armed
+    uint rx_head;
+    uint rx_base;
+} stream;
+
+// Results the RX channel is armed for. Re-armed when idle and running low.
+#define PROBE_RX_ARM            0x0fffffffu
+#define PROBE_RX_REARM          0x08000000u
+
+// SWCLK bit period limits in PIO cycles, set by the loop delay field width
+#if defined(PROBE_IO_OEN)
+#define PROBE_DELAY_BITS        2
+#define PROBE_CYCLES_MAX        8
+// Side-set values with SWDIO_OEn disabled
+#define PROBE_SIDE_CLK_LOW      0x1
+#define PROBE_SIDE_CLK_HIGH     0x3
+#else
+#define PROBE_DELAY_BITS        3
+#define PROBE_CYCLES_MAX        16
+#define PROBE_SIDE_CLK_LOW      0x0
+#define PROBE_SIDE_CLK_HIGH     0x1
+#endif
+// Keep the side-set of the original instruction
+#define PROBE_SIDE_KEEP         (-1)
+#define PROBE_CYCLES_MIN        4
+
+// Shortest period, in clk_sys cycles, that may use the fractional divider.
+// The divider dithers by one clk_sys cycle, which only moves the SWCLK edge
+// within the period - at 20 cycles that is at most 10% of a half period.
+#define PROBE_FRAC_CYCLES_MIN   20
+
+// Rewrite the side-set and delay fields of a loaded probe program instruction.
+// Both programs use an optional side-set, enabled by bit 12.
+static void probe_patch(uint index, int side, uint delay) {
+    uint16_t instr = probe_program.instructions[index];
+    // Relocate as pio_add_program() did
+    if (_pio_major_instr_bits(instr) == pio_instr_bits_jmp)
+        instr += probe.offset;
+    if (side == PROBE_SIDE_KEEP) {
+        instr &= ~(((1u << PROBE_DELAY_BITS) - 1) << 8);
+    } else {
+        instr &= ~(0x1fu << 8);
+        instr |= (1u << 12) | ((uint)side << (8 + PROBE_DELAY_BITS));
+    }
+    instr |= delay << 8;
+    pio0->instr_mem[probe.offset + index] = instr;
+}
+
+static inline void probe_patch_delay(uint index, uint delay) {
+    probe_patch(index, PROBE_SIDE_KEEP, delay);
+}
+
+// Sample SWDIO in a read or ACK loop (filler; in; jmp) sample PIO cycles after
+// the rising edge. With no delay the in instruction raises SWCLK and samples
+// at once. Otherwise the filler raises SWCLK and the in instruction follows,
+// still high or - at the largest delay - lowering SWCLK as it samples.
+static void probe_set_sample_point(uint loop, uint high, uint low, uint sample) {
+    if (sample == 0) {
+        probe_patch(loop + 0, PROBE_SIDE_KEEP, low - 2);
+        probe_patch(loop + 1, PROBE_SIDE_CLK_HIGH, high - 1);
+        probe_patch(loop + 2, PROBE_SIDE_CLK_LOW, 0);
+    } else if (sample < high) {
+        probe_patch(loop + 0, PROBE_SIDE_CLK_HIGH, sample - 1);
+        probe_patch(loop + 1, PROBE_SIDE_CLK_HIGH, high - sample - 1);
+        probe_patch(loop + 2, PROBE_SIDE_CLK_LOW, low - 1);
+    } else {
+        probe_patch(loop + 0, PROBE_SIDE_CLK_HIGH, high - 1);
+        probe_patch(loop + 1, PROBE_SIDE_CLK_LOW, 0);
+        probe_patch(loop + 2, PROBE_SIDE_CLK_LOW, low - 2);
+    }
+}
+
+// Set the delays in the bit loops for a bit period of cycles PIO cycles,
+// SWCLK low for the first (longer) half and high for the second, and the
+// SWDIO sample point. The sample delay is limited to the high half.
+static uint probe_set_bit_timing(uint cycles, uint sample) {
+    uint high = cycles / 2;
+    uint low = cycles - high;
+
+    if (sample > high)
+        sample = high;
+
+    // write_cmd, and turnaround_cmd in probe.pio: pull ifempty; out; jmp
+    probe_patch_delay(probe_offset_write_bitloop + 1, low - 2);
+    probe_patch_delay(probe_offset_write_bitloop + 2, high - 1);
+#if defined(PROBE_IO_OEN)
+    // turnaround_cmd in probe_oen.pio: nop; jmp
+    probe_patch_delay(probe_offset_turnaround_bitloop + 0, low - 1);
+    probe_patch_delay(probe_offset_turnaround_bitloop + 1, high - 1);
+#endif
+    // read_cmd: push iffull; in; jmp. A delayed sample point raises SWCLK
+    // on the push, so reads then start there rather than at read_cmd.
+    probe_set_sample_point(probe_offset_read_bitloop, high, low, sample);
+    probe.read_cmd = sample ? probe_offset_read_bitloop : probe_offset_read_cmd;
+    // txn_cmd request loop: out; jmp
+    probe_patch_delay(probe_offset_txn_cmd + 0, low - 1);
+    probe_patch_delay(probe_offset_txn_cmd + 1, high - 1);
+    // txn_cmd ACK loop: set; in; jmp. The set y before it makes up the low
+    // half of the turnaround bit when the loop's set no longer does.
+    probe_set_sample_point(probe_offset_txn_ackloop, high, low, sample);
+    probe_patch_delay(probe_offset_txn_ackloop - 1, sample ? low - 2 : 0);
+    // Turnaround after a failed ACK is SWCLK high across pull; jmp; jmp
+    probe_patch_delay(probe_offset_txn_skip + 2, high > 3 ? high - 3 : 0);
+    return sample;
+}
+
+// The sample delay in whole PIO cycles at clk's divider, rounded down.
+// It is kept in clk_sys cycles, as the round trip it makes up for does not
+// stretch with SWCLK: at a slow SWCLK one PIO cycle can outlast the target's
+// output hold time, and a sample that late takes the next bit.
+static uint probe_sample_cycles(const probe_clock_t *clk, uint sample) {
+    return (sample << 8) / (((uint)clk->div_int << 8) | clk->div_frac);
+}
+
+// Pick the fastest SWCLK that is not above freq_hz. The SWCLK period is a
+// whole number of clk_sys cycles, made up either as exact integer divider *
+// PIO cycles per bit, or - for slower clocks - with the fractional divider
+// over 4 PIO cycles per bit, where every period is still exact.
+void probe_plan_swclk(uint32_t freq_hz, probe_clock_t *clk) {
+    uint32_t clk_sys_freq = clock_get_hz(clk_sys);
+    uint32_t period = DIV_ROUND_UP(clk_sys_freq, freq_hz ? freq_hz : 1);
+    uint sample;
+
+    if (period < PROBE_CYCLES_MIN)
+        period = PROBE_CYCLES_MIN;
+    if (period > PROBE_CYCLES_MAX * 65535)
+        period = PROBE_CYCLES_MAX * 65535;
+
+    for (;; period++) {
+        // Prefer the most PIO cycles per bit, for the finest sample timing
+        for (uint cycles = PROBE_CYCLES_MAX; cycles >= PROBE_CYCLES_MIN; cycles--) {
+            if ((period % cycles) == 0 && (period / cycles) <= 65535) {
+                clk->cycles = cycles;
+                clk->div_int = period / cycles;
+                clk->div_frac = 0;
+                goto found;
+            }
+        }
+        if (period >= PROBE_FRAC_CYCLES_MIN && (period / PROBE_CYCLES_MIN) <= 65535) {
+            clk->cycles = PROBE_CYCLES_MIN;
+            clk->div_int = period / PROBE_CYCLES_MIN;
+            clk->div_frac = (period % PROBE_CYCLES_MIN) * (256 / PROBE_CYCLES_MIN);
+            goto found;
+        }
+    }
+found:
+    // Rounded up, so that planning for freq_hz again gets the same period
+    // rather than the next one down
+    clk->freq_hz = DIV_ROUND_UP(clk_sys_freq, period);
+    sample = probe_sample_cycles(clk, probe.sample_delay);
+    clk->sample_delay = sample < clk->cycles / 2U ? sample : clk->cycles / 2U;
+}
+
+uint32_t probe_set_swclk_freq(uint32_t freq_hz) {
+    probe_plan_swclk(freq_hz, &probe.clock);
+
+    // The bit loops are rewritten in place, so let everything queued finish
+    probe_stream_sync();
+    probe_wait_idle();
+    probe.clock.sample_delay = probe_set_bit_timing(probe.clock.cycles, probe.clock.sample_delay);
+    pio_sm_set_clkdiv_int_frac(pio0, PROBE_SM, probe.clock.div_int, probe.clock.div_frac);
+    probe_info("Set swclk freq %luHz: %luHz, %d cycles/bit, div %d+%d/256, sample +%d\n",
+               (unsigned long)freq_hz, (unsigned long)probe.clock.freq_hz,
+               probe.clock.cycles, probe.clock.div_int, probe.clock.div_frac,
+               probe.clock.sample_delay);
+    return probe.clock.freq_hz;
+}
+
+uint probe_set_sample_delay(uint cycles) {
+    probe.sample_delay = cycles;
+    if (!probe.initted)
+        return cycles;
 
-void probe_set_swclk_freq(uint freq_khz) {
-        uint clk_sys_freq_khz = clock_get_hz(clk_sys) / 1000;
-        probe_info("Set swclk freq %dKHz sysclk %dkHz\n", freq_khz, clk_sys_freq_khz);
-        // Round up (otherwise fast swclks get faster)
-        uint32_t divider = (((clk_sys_freq_khz + freq_khz - 1)/ freq_khz) + 3) / 4;
-        if (divider == 0)
-            divider = 1;
-        if (divider > 65535)
-            divider = 65535;
+    probe_stream_sync();
+    probe_wait_idle();
+    probe.clock.sample_delay = probe_set_bit_timing(probe.clock.cycles,
+                                                    probe_sample_cycles(&probe.clock, cycles));
+    probe_info("Set sample delay %d: %d\n", cycles, probe.clock.sample_delay);
+    return probe.clock.sample_delay;
+}
 
-        pio_sm_set_clkdiv_int_frac(pio0, PROBE_SM, divider, 0);
+const probe_clock_t *probe_get_swclk(void) {
+    return &probe.clock;
 }
 
 void probe_assert_reset(bool state)
@@ -92,7 +295,8 @@ typedef enum probe_pio_command {
     CMD_WRITE = 0,
     CMD_SKIP,
     CMD_TURNAROUND,
-    CMD_READ
+    CMD_READ,
+    CMD_TXN
 } probe_pio_command_t;
 
 static inline uint32_t fmt_probe_command(uint bit_count, bool out_en, probe_pio_command_t cmd) {
@@ -100,54 +304,236 @@ static inline uint32_t fmt_probe_command(uint bit_count, bool out_en, probe_pio_
         cmd == CMD_WRITE      ? probe.offset + probe_offset_write_cmd :
         cmd == CMD_SKIP       ? probe.offset + probe_offset_get_next_cmd :
         cmd == CMD_TURNAROUND ? probe.offset + probe_offset_turnaround_cmd :
-                                probe.offset + probe_offset_read_cmd;
+        cmd == CMD_TXN        ? probe.offset + probe_offset_txn_cmd :
+                                probe.offset + probe.read_cmd;
     return ((bit_count - 1) & 0xff) | ((uint)out_en << 8) | (cmd_addr << 9);
 }
 
+// Data entries needed by a write or turnaround command, or pushed by a read
+#define PROBE_WORDS(bit_count)   DIV_ROUND_UP(bit_count, 32)
+
+// Skip count of every txn: more than can ever be queued, so a failed ACK
+// drops everything behind it and the SM then waits in txn_skip to be cancelled
+#define PROBE_TXN_SKIP_ALL      0x3ffu
+
+// Words the TX channel has yet to read
+static inline uint probe_tx_pending(void) {
+    uint pending = stream.tx_head - stream.tx_sent;
+    if (dma_channel_is_busy(probe.tx_dma))
+        pending += dma_channel_hw_addr(probe.tx_dma)->transfer_count;
+    return pending;
+}
+
+// Results the RX channel has written so far
+static inline uint probe_rx_done(void) {
+    return stream.rx_base + PROBE_RX_ARM -
+           (dma_channel_hw_addr(probe.rx_dma)->transfer_count & PROBE_RX_ARM);
+}
+
+// Hand whatever has been queued since the last time to the TX channel. A
+// channel still busy with earlier words is left alone; this is called again
+// from every wait on the stream.
+static void probe_stream_kick(void) {
+    if (stream.tx_sent != stream.tx_head && !dma_channel_is_busy(probe.tx_dma)) {
+        dma_channel_transfer_from_buffer_now(probe.tx_dma,
+                                             &stream_tx[stream.tx_sent % PROBE_STREAM_WORDS],
+                                             stream.tx_head - stream.tx_sent);
+        stream.tx_sent = stream.tx_head;
+    }
+}
+
+static inline void probe_stream_put(uint32_t word) {
+    while (probe_tx_pending() >= PROBE_STREAM_WORDS)
+        probe_stream_kick();
+    stream_tx[stream.tx_head++ % PROBE_STREAM_WORDS] = word;
+}
+
+static void probe_rx_arm(void) {
+    uint done = probe_rx_done();
+
+    dma_channel_abort(probe.rx_dma);
+    stream.rx_base = done;
+    dma_channel_transfer_to_buffer_now(probe.rx_dma, &stream_rx[done % PROBE_STREAM_READS], PROBE_RX_ARM);
+}
+
+// Everything queued has gone into the FIFO
+static inline void probe_stream_sync(void) {
+    do {
+        probe_stream_kick();
+    } while (stream.tx_sent != stream.tx_head || dma_channel_is_busy(probe.tx_dma));
+}
+
 void probe_write_bits(uint bit_count, uint32_t data_byte) {
     DEBUG_PINS_SET(probe_timing, DBG_PIN_WRITE);
-    pio_sm_put_blocking(pio0, PROBE_SM, fmt_probe_command(bit_count, true, CMD_WRITE));
-    pio_sm_put_blocking(pio0, PROBE_SM, data_byte);
+    probe_stream_write_bits(bit_count, data_byte);
+    probe_stream_run();
     probe_dump("Write %d bits 0x%x\n", bit_count, data_byte);
     // Return immediately so we can cue up the next command whilst this one runs
     DEBUG_PINS_CLR(probe_timing, DBG_PIN_WRITE);
 }
 
 void probe_hiz_clocks(uint bit_count) {
-    pio_sm_put_blocking(pio0, PROBE_SM, fmt_probe_command(bit_count, false, CMD_TURNAROUND));
-    pio_sm_put_blocking(pio0, PROBE_SM, 0);
+    probe_stream_hiz_clocks(bit_count);
+    probe_stream_run();
 }
 
 uint32_t probe_read_bits(uint bit_count) {
     DEBUG_PINS_SET(probe_timing, DBG_PIN_READ);
-    pio_sm_put_blocking(pio0, PROBE_SM, fmt_probe_command(bit_count, false, CMD_READ));
-    uint32_t data = pio_sm_get_blocking(pio0, PROBE_SM);
-    uint32_t data_shifted = data;
-    if (bit_count < 32) {
-        data_shifted = data >> (32 - bit_count);
-    }
+    uint index = probe_stream_read_bits(bit_count);
+    probe_stream_run();
+    uint32_t data = probe_stream_result(index);
+    // Only the first 32 bits are returned
+    for (uint i = 1; i < PROBE_WORDS(bit_count); i++)
+        (void)probe_stream_result(index + i);
 
-    probe_dump("Read %d bits 0x%x (shifted 0x%x)\n", bit_count, data, data_shifted);
+    probe_dump("Read %d bits 0x%x\n", bit_count, data);
     DEBUG_PINS_CLR(probe_timing, DBG_PIN_READ);
-    return data_shifted;
+    return data;
+}
+
+void probe_stream_write_bits(uint bit_count, uint32_t data) {
+    probe_stream_put(fmt_probe_command(bit_count, true, CMD_WRITE));
+    probe_stream_put(data);
+    for (uint i = 1; i < PROBE_WORDS(bit_count); i++)
+        probe_stream_put(0);
+}
+
+void probe_stream_write_parity(uint32_t data) {
+    probe_stream_put(fmt_probe_command(33, true, CMD_WRITE));
+    probe_stream_put(data);
+    probe_stream_put(__builtin_popcount(data) & 0x1);
+}
+
+void probe_stream_write_buf(uint bit_count, const uint8_t *data) {
+    probe_stream_put(fmt_probe_command(bit_count, true, CMD_WRITE));
+    // LSB first on the wire, so bytes pack little-endian into the data entries
+    for (uint n = 0; n < DIV_ROUND_UP(bit_count, 8); n += 4) {
+        uint32_t word = 0;
+        for (uint i = 0; i < 4 && n + i < DIV_ROUND_UP(bit_count, 8); i++)
+            word |= (uint32_t)data[n + i] << (8 * i);
+        probe_stream_put(word);
+    }
+}
+
+void probe_stream_hiz_clocks(uint bit_count) {
+    probe_stream_put(fmt_probe_command(bit_count, false, CMD_TURNAROUND));
+#if defined(PROBE_IO_OEN)
+    // turnaround_cmd in probe_oen.pio takes one data entry however long the run
+    probe_stream_put(0);
+#else
+    for (uint i = 0; i < PROBE_WORDS(bit_count); i++)
+        probe_stream_put(0);
+#endif
+}
+
+uint probe_stream_read_bits(uint bit_count) {
+    uint index = stream.rx_head;
+
+    probe_stream_put(fmt_probe_command(bit_count, false, CMD_READ));
+    for (; bit_count > 32; bit_count -= 32)
+        stream.rx_bits[stream.rx_head++ % PROBE_STREAM_READS] = 32;
+    stream.rx_bits[stream.rx_head++ % PROBE_STREAM_READS] = bit_count;
+    return index;
+}
+
+void probe_stream_read_buf(uint index, uint bit_count, uint8_t *data) {
+    for (uint n = 0; n < DIV_ROUND_UP(bit_count, 8); n += 4) {
+        uint32_t word = probe_stream_result(index++);
+        for (uint i = 0; i < 4 && n + i < DIV_ROUND_UP(bit_count, 8); i++)
+            data[n + i] = (uint8_t)(word >> (8 * i));
+    }
+}
+
+uint probe_stream_txn(uint8_t request) {
+    probe_stream_put(fmt_probe_command(8, true, CMD_TXN) | ((uint32_t)request << 14) |
+                     (PROBE_TXN_SKIP_ALL << 22));
+    stream.rx_bits[stream.rx_head % PROBE_STREAM_READS] = 3;
+    return stream.rx_head++;
+}
+
+void probe_stream_run(void) {
+    DEBUG_PINS_SET(probe_timing, DBG_PIN_PKT);
+    probe_stream_kick();
+    probe_dump("Stream %d words %d reads\n", stream.tx_head, stream.rx_head);
+    DEBUG_PINS_CLR(probe_timing, DBG_PIN_PKT);
+}
+
+uint32_t probe_stream_result(uint index) {
+    // Results land in order, so wait for this one
+    while ((int)(probe_rx_done() - index) <= 0)
+        probe_stream_kick();
+    __compiler_memory_barrier();
+
+    uint32_t data = stream_rx[index % PROBE_STREAM_READS];
+    if (stream.rx_bits[index % PROBE_STREAM_READS] < 32)
+        data >>= 32 - stream.rx_bits[index % PROBE_STREAM_READS];
+
+    // Top up the RX channel while nothing is due from it
+    if (index + 1 == stream.rx_head &&
+        (dma_channel_hw_addr(probe.rx_dma)->transfer_count & PROBE_RX_ARM) < PROBE_RX_REARM)
+        probe_rx_arm();
+    return data;
+}
+
+void probe_stream_cancel(void) {
+    // After a failed ACK the SM drops every entry it is given, so stop feeding
+    // it, wait for it to run dry in txn_skip and send it back to dispatch
+    dma_channel_abort(probe.tx_dma);
+    uint pc;
+    do {
+        pc = pio_sm_get_pc(pio0, PROBE_SM) - probe.offset;
+    } while (pc < probe_offset_txn_skip || pc > probe_offset_txn_skip + 2);
+    pio_sm_clear_fifos(pio0, PROBE_SM);
+    pio_sm_exec(pio0, PROBE_SM, pio_encode_jmp(probe.offset + probe_offset_get_next_cmd));
+
+    stream.tx_sent = stream.tx_head;
+    stream.rx_head = probe_rx_done();
 }
 
-static void probe_wait_idle() {
+static void probe_wait_idle(void) {
     pio0->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + PROBE_SM);
     while (!(pio0->fdebug & (1u << (PIO_FDEBUG_TXSTALL_LSB + PROBE_SM))))
         ;
 }
 
 void probe_read_mode(void) {
-    pio_sm_put_blocking(pio0, PROBE_SM, fmt_probe_command(0, false, CMD_SKIP));
+    probe_stream_put(fmt_probe_command(0, false, CMD_SKIP));
+    probe_stream_sync();
     probe_wait_idle();
 }
 
 void probe_write_mode(void) {
-    pio_sm_put_blocking(pio0, PROBE_SM, fmt_probe_command(0, true, CMD_SKIP));
+    probe_stream_put(fmt_probe_command(0, true, CMD_SKIP));
+    probe_stream_sync();
     probe_wait_idle();
 }
 
+static void probe_dma_init(void) {
+    dma_channel_config c;
+
+    probe.tx_dma = dma_claim_unused_channel(true);
+    c = dma_channel_get_default_config(probe.tx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, __builtin_ctz(sizeof(stream_tx)));
+    channel_config_set_dreq(&c, pio_get_dreq(pio0, PROBE_SM, true));
+    dma_channel_configure(probe.tx_dma, &c, &pio0->txf[PROBE_SM], NULL, 0, false);
+
+    probe.rx_dma = dma_claim_unused_channel(true);
+    c = dma_channel_get_default_config(probe.rx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, __builtin_ctz(sizeof(stream_rx)));
+    channel_config_set_dreq(&c, pio_get_dreq(pio0, PROBE_SM, false));
+    dma_channel_configure(probe.rx_dma, &c, NULL, &pio0->rxf[PROBE_SM], 0, false);
+
+    stream.tx_head = stream.tx_sent = 0;
+    stream.rx_head = stream.rx_base = 0;
+    dma_channel_transfer_to_buffer_now(probe.rx_dma, stream_rx, PROBE_RX_ARM);
+}
+
 void probe_init() {
     if (!probe.initted) {
         probe_gpio_init();
@@ -158,12 +544,14 @@ void probe_init() {
         probe_sm_init(&sm_config);
         pio_sm_init(pio0, PROBE_SM, offset, &sm_config);
 
-        // Set up divisor
-        probe_set_swclk_freq(1000);
+        probe_dma_init();
 
         // Jump SM to command dispatch routine, and enable it
         pio_sm_exec(pio0, PROBE_SM, offset + probe_offset_get_next_cmd);
         pio_sm_set_enabled(pio0, PROBE_SM, 1);
+
+        // Set up divisor and bit period
+        probe_set_swclk_freq(1000000);
         probe.initted = 1;
     }
 }
@@ -173,7 +561,10 @@ void probe_deinit(void)
   if (probe.initted) {
     probe_read_mode();
     pio_sm_set_enabled(pio0, PROBE_SM, 0);
+    dma_channel_abort(probe.rx_dma);
     pio_remove_program(pio0, &probe_program, probe.offset);
+    dma_channel_unclaim(probe.tx_dma);
+    dma_channel_unclaim(probe.rx_dma);
 
     probe_assert_reset(1);	// de-assert nRESET
     probe_gpio_deinit();
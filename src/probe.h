@@ -26,21 +26,66 @@
 #ifndef PROBE_H_
 #define PROBE_H_
 
-#if defined(PROBE_IO_RAW) || defined(PROBE_IO_SWDI)
-#include "probe.pio.h"
-#endif
+#include <stdbool.h>
+#include <stdint.h>
 
-#if defined(PROBE_IO_OEN)
-#include "probe_oen.pio.h"
-#endif
+typedef struct {
+    uint32_t freq_hz;       // Achieved SWCLK frequency
+    uint16_t div_int;       // PIO clock divider
+    uint8_t div_frac;
+    uint8_t cycles;         // PIO cycles per SWCLK period
+    uint8_t sample_delay;   // SWDIO sampled this many PIO cycles after the rising edge
+} probe_clock_t;
 
-void probe_set_swclk_freq(uint freq_khz);
+// Fastest SWCLK setting not above freq_hz
+void probe_plan_swclk(uint32_t freq_hz, probe_clock_t *clk);
+// Program it, returning the achieved frequency
+uint32_t probe_set_swclk_freq(uint32_t freq_hz);
+const probe_clock_t *probe_get_swclk(void);
+// Delay the SWDIO sample point by cycles of clk_sys, to make up for the
+// round trip through buffers and cables. Returns the delay in use, in PIO
+// cycles: rounded down to whole ones at the current divider and limited to
+// the high half of the bit period.
+uint probe_set_sample_delay(uint cycles);
 
-// Bit counts in the range 1..256
+// Bit counts in the range 1..256. Writes beyond 32 bits clock out zeros,
+// reads beyond 32 bits return only the first 32.
 void probe_write_bits(uint bit_count, uint32_t data_byte);
 uint32_t probe_read_bits(uint bit_count);
 void probe_hiz_clocks(uint bit_count);
 
+// DMA-fed command stream. Commands are queued in a ring in RAM by the
+// probe_stream_* calls and handed to the SM by probe_stream_run(), which
+// returns without waiting. More can be queued while they run; the ring is
+// topped up from every wait on the stream. Read results are collected in
+// order by a free-running DMA channel and fetched by the index returned when
+// the read was queued, shifted down to the LSBs; probe_stream_result() waits
+// for that result. At most PROBE_STREAM_READS results may be outstanding.
+// Reads of more than 32 bits take one result per 32 bits, and the _buf
+// variants pack whole sequences LSB first into bytes.
+//
+// probe_stream_txn() queues the request and ACK phase of an SWD transfer.
+// The SM checks the ACK itself and on anything but OK drops everything queued
+// behind it, so after a failed ACK the caller must probe_stream_cancel()
+// instead of waiting for later results, and queue again whatever it still
+// wants sent.
+//
+// The direct bit calls above are shorthands for a command on the stream.
+#define PROBE_STREAM_WORDS 512
+#define PROBE_STREAM_READS 64
+
+void probe_stream_write_bits(uint bit_count, uint32_t data);
+void probe_stream_write_buf(uint bit_count, const uint8_t *data);
+// 32 data bits followed by their parity bit
+void probe_stream_write_parity(uint32_t data);
+void probe_stream_hiz_clocks(uint bit_count);
+uint probe_stream_read_bits(uint bit_count);
+void probe_stream_read_buf(uint index, uint bit_count, uint8_t *data);
+uint probe_stream_txn(uint8_t request);
+void probe_stream_run(void);
+uint32_t probe_stream_result(uint index);
+void probe_stream_cancel(void);
+
 void probe_read_mode(void);
 void probe_write_mode(void);
 
@@ -65,13 +65,42 @@ do { \
 
 // TODO tie this up with PICO_BOARD defines in the main SDK
 
-#ifdef DEBUG_ON_PICO 
+#if defined(PROBE_BOARD_CONFIG)
+#include PROBE_BOARD_CONFIG
+#elif defined(DEBUG_ON_PICO)
 #include "board_pico_config.h"
 #else
 #include "board_debug_probe_config.h"
 #endif
 //#include "board_example_config.h"
 
+// SWDIO sample point, in clk_sys cycles after the SWCLK rising edge, rounded
+// down to whole PIO cycles at the SWCLK divider. Boards with buffers or long
+// cables on SWDIO can set a later default.
+#ifndef PROBE_SAMPLE_DELAY
+#define PROBE_SAMPLE_DELAY 0
+#endif
+
+// Calibrate SWCLK and the sample delay against the target on every
+// DAP_Connect, as ID_DAP_Probe_Calibrate does. The rate chosen is the
+// fastest error-free one stepped down PROBE_CALIBRATE_MARGIN times, each
+// step trying PROBE_CALIBRATE_ROUNDS rounds of reads.
+#ifndef PROBE_SWD_CALIBRATE
+#define PROBE_SWD_CALIBRATE 0
+#endif
+#ifndef PROBE_CALIBRATE_MARGIN
+#define PROBE_CALIBRATE_MARGIN 1
+#endif
+#ifndef PROBE_CALIBRATE_ROUNDS
+#define PROBE_CALIBRATE_ROUNDS 64
+#endif
+
+// Stream AP write blocks without waiting on each ACK, under the DP's
+// overrun detection. Also switched by PROBE_OPT_BLIND_WRITES.
+#ifndef PROBE_SWD_BLIND_WRITES
+#define PROBE_SWD_BLIND_WRITES 0
+#endif
+
 // Add the configuration to binary information
 void bi_decl_config();
 
@@ -83,4 +112,28 @@ void bi_decl_config();
 #define PROBE_DEBUG_PROTOCOL PROTO_DAP_V2
 #endif
 
+// DAP packet size on the CMSIS-DAP v2 bulk interface, 64 to 1024 bytes.
+// Larger packets span several full-speed USB packets, ended by a short
+// packet or a ZLP. CMSIS-DAP v1 HID reports stay at 64 bytes.
+#ifndef PROBE_DAP_PACKET_SIZE
+#define PROBE_DAP_PACKET_SIZE 512
+#endif
+
+// RAM for the bulk interface's request and response rings, split evenly
+// between them, and the number of packets each holds at power-up. The
+// packet count and size can be changed by ID_DAP_Probe_PacketConfig within
+// this space, with PROBE_DAP_PACKET_SIZE as the largest packet.
+#ifndef PROBE_DAP_RING_SIZE
+#define PROBE_DAP_RING_SIZE 16384
+#endif
+#ifndef PROBE_DAP_PACKET_COUNT
+#define PROBE_DAP_PACKET_COUNT 16
+#endif
+
+// Space for the responses to a DAP_QueueCommands batch, held back until the
+// batch is closed. Each takes two bytes more than the response itself.
+#ifndef PROBE_DAP_QUEUE_SIZE
+#define PROBE_DAP_QUEUE_SIZE 4096
+#endif
+
 #endif
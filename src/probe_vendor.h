@@ -0,0 +1,80 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Raspberry Pi (Trading) Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef PROBE_VENDOR_H_
+#define PROBE_VENDOR_H_
+
+#include "DAP.h"
+
+// Debugprobe vendor commands. All values are little-endian, every response
+// starts with the command ID and a DAP_OK/DAP_ERROR status byte.
+
+// Set the idle cycles clocked between WAIT retries
+//   request:  u16 cycles
+#define ID_DAP_Probe_WaitBackoff    ID_DAP_Vendor0
+
+// Read the WAIT retry counters
+//   response: u32 total retries, u32 retries of the last transfer
+#define ID_DAP_Probe_WaitRetries    ID_DAP_Vendor1
+
+// Read the SWCLK setting that transfers run at from now on. DAP_SWJ_Clock
+// keeps its standard one-byte response, so this is where the actual rate is.
+//   response: u32 requested Hz, u32 actual Hz, u8 PIO cycles per bit,
+//             u16 divider integer part, u8 divider fraction (/256),
+//             u8 SWDIO sample delay in PIO cycles
+#define ID_DAP_Probe_ClockInfo      ID_DAP_Vendor2
+
+// Set a probe option
+//   request:  u8 option, u32 value
+#define ID_DAP_Probe_SetOption      ID_DAP_Vendor3
+
+// Calibrate SWCLK and the sample delay against the connected target now.
+// Leaves the target's debug domain powered up and AP 0 selected.
+//   response: u32 SWCLK ceiling Hz, u8 SWDIO sample delay in clk_sys cycles
+#define ID_DAP_Probe_Calibrate      ID_DAP_Vendor4
+
+// Set the packet count and size of the bulk interface's request and response
+// rings, taking effect at the next USB reset. DAP_Info reports the layout in
+// use. A count of 0 leaves it unchanged. Not available over HID.
+//   request:  u8 packet count, u16 packet size
+//   response: u8 packet count, u16 packet size, for the next USB reset
+#define ID_DAP_Probe_PacketConfig   ID_DAP_Vendor5
+
+// Read the activity counters: USB and DAP task wakeups, commands run, and
+// the total and worst time from a request arriving to its response being
+// queued. Wakeups over a period with no commands show the idle load. The
+// DAP endpoint byte counts over the period give the sustained throughput.
+//   request:  u8 non-zero to clear the counters after reading
+//   response: u32 USB task wakeups, u32 DAP task wakeups, u32 commands,
+//             u32 total latency us, u32 worst latency us,
+//             u32 bytes received, u32 bytes sent, u32 us since cleared
+#define ID_DAP_Probe_Stats          ID_DAP_Vendor6
+
+// Options for ID_DAP_Probe_SetOption
+#define PROBE_OPT_SAMPLE_DELAY      1U  // SWDIO sample point in clk_sys cycles after the SWCLK rising edge
+#define PROBE_OPT_CALIBRATE         2U  // Non-zero: calibrate on every DAP_Connect. Zero also drops the SWCLK ceiling
+#define PROBE_OPT_BLIND_WRITES      3U  // Non-zero: stream AP write blocks under DP overrun detection
+
+#endif
@@ -0,0 +1,332 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Raspberry Pi (Trading) Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+/*
+ * SWCLK calibration. Steps through SWCLK rates, fastest first, and at each
+ * one through the SWDIO sample delays, running DPIDR reads and MEM-AP TAR
+ * write/read-backs through SWD_Transfer(). The fastest rate with an error-free
+ * sample delay, less a margin, becomes the ceiling for DAP_SWJ_Clock, and the
+ * sample delay in the middle of the passing ones is locked in.
+ */
+
+#include <pico/stdlib.h>
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "probe.h"
+#include "sw_dp_pio.h"
+
+#if (DAP_SWD != 0)
+
+// SWCLK periods tried, in clk_sys cycles, fastest first
+static const uint16_t cal_periods[] = {
+  4, 5, 6, 7, 8, 10, 12, 14, 16, 20, 24, 32, 40, 48, 64
+};
+
+#define DIV_ROUND_UP(m, n)  (((m) + (n) - 1) / (n))
+
+// Known-good rate for reference values and recovery after a failed trial
+#define CAL_REF_CLOCK     1000000U
+
+// Attempts at a transfer that gets WAIT
+#define CAL_WAIT_RETRY    100U
+
+// DP CTRL/STAT power-up request and acknowledge bits
+#define CAL_PWRUPREQ      0x50000000U
+#define CAL_PWRUPACK      0xA0000000U
+
+// MEM-AP Transfer Address Register, bank 0
+#define CAL_AP_TAR        0x04U
+
+// Clear all sticky errors through DP ABORT
+#define CAL_ABORT_CLEAR   0x0000001EU
+
+// Written to AP 0 TAR and read back, exercising both data directions
+static const uint32_t cal_patterns[] = {
+  0x00000000U, 0xFFFFFFFFU, 0xAAAAAAAAU, 0x55555555U,
+  0x12345678U, 0xEDCBA987U, 0x80000001U, 0x7FFFFFFEU
+};
+
+// Reads taken at the reference rate
+static struct {
+  uint32_t dpidr;
+  uint32_t tar[count_of(cal_patterns)];
+  uint8_t  mem_ap;
+} cal_ref;
+
+static uint8_t calibrate_on_connect = PROBE_SWD_CALIBRATE;
+static probe_calibration_t cal_result;
+
+static uint8_t cal_transfer (uint32_t request, uint32_t *data) {
+  uint32_t n = CAL_WAIT_RETRY;
+  uint8_t ack;
+
+  do {
+    ack = SWD_Transfer(request, data);
+  } while ((ack == DAP_TRANSFER_WAIT) && --n);
+  return ack;
+}
+
+// Line reset, JTAG-to-SWD, line reset and idle, then the DPIDR read that
+// leaves the reset state
+static uint8_t cal_line_reset (uint32_t *dpidr) {
+  static const uint8_t ones[7]     = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+  static const uint8_t jtag2swd[2] = { 0x9E, 0xE7 };
+  static const uint8_t idle[1]     = { 0x00 };
+
+  SWJ_Sequence(56U, ones);
+  SWJ_Sequence(16U, jtag2swd);
+  SWJ_Sequence(56U, ones);
+  SWJ_Sequence(8U, idle);
+  return cal_transfer(DAP_TRANSFER_RnW | DP_IDCODE, dpidr);
+}
+
+// Back to the reference rate with the sticky errors cleared and AP 0 bank 0 selected
+static uint8_t cal_recover (void) {
+  uint32_t val;
+
+  SWJ_SetClock(CAL_REF_CLOCK);
+  probe_set_sample_delay(PROBE_SAMPLE_DELAY);
+  if ((cal_line_reset(&val) != DAP_TRANSFER_OK) || (val != cal_ref.dpidr)) {
+    return 0U;
+  }
+  val = CAL_ABORT_CLEAR;
+  if (cal_transfer(DP_ABORT, &val) != DAP_TRANSFER_OK) {
+    return 0U;
+  }
+  val = 0U;
+  return (cal_transfer(DP_SELECT, &val) == DAP_TRANSFER_OK);
+}
+
+// Take the reference reads. MEM-AP read-backs are only used if AP 0
+// answers them at the reference rate.
+static uint8_t cal_reference (void) {
+  uint32_t val;
+  uint32_t n;
+
+  SWJ_SetClock(CAL_REF_CLOCK);
+  probe_set_sample_delay(PROBE_SAMPLE_DELAY);
+  if (cal_line_reset(&cal_ref.dpidr) != DAP_TRANSFER_OK) {
+    return 0U;
+  }
+  if (!cal_recover()) {
+    return 0U;
+  }
+
+  cal_ref.mem_ap = 0U;
+  val = CAL_PWRUPREQ;
+  if (cal_transfer(DP_CTRL_STAT, &val) != DAP_TRANSFER_OK) {
+    return 1U;
+  }
+  for (n = 0U; n < CAL_WAIT_RETRY; n++) {
+    if (cal_transfer(DAP_TRANSFER_RnW | DP_CTRL_STAT, &val) != DAP_TRANSFER_OK) {
+      return 1U;
+    }
+    if ((val & CAL_PWRUPACK) == CAL_PWRUPACK) {
+      break;
+    }
+  }
+  if (n == CAL_WAIT_RETRY) {
+    return 1U;
+  }
+
+  for (n = 0U; n < count_of(cal_patterns); n++) {
+    val = cal_patterns[n];
+    if ((cal_transfer(DAP_TRANSFER_APnDP | CAL_AP_TAR, &val) != DAP_TRANSFER_OK) ||
+        (cal_transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | CAL_AP_TAR, NULL) != DAP_TRANSFER_OK) ||
+        (cal_transfer(DAP_TRANSFER_RnW | DP_RDBUFF, &cal_ref.tar[n]) != DAP_TRANSFER_OK)) {
+      return cal_recover();
+    }
+  }
+  cal_ref.mem_ap = 1U;
+  return 1U;
+}
+
+// Any ACK other than OK, a parity error or a read not matching the
+// reference fails the trial
+static uint8_t cal_trial (void) {
+  uint32_t val;
+  uint32_t n;
+
+  for (n = 0U; n < PROBE_CALIBRATE_ROUNDS; n++) {
+    if ((cal_transfer(DAP_TRANSFER_RnW | DP_IDCODE, &val) != DAP_TRANSFER_OK) ||
+        (val != cal_ref.dpidr)) {
+      return 0U;
+    }
+    if (cal_ref.mem_ap) {
+      uint32_t i = n % count_of(cal_patterns);
+      val = cal_patterns[i];
+      if ((cal_transfer(DAP_TRANSFER_APnDP | CAL_AP_TAR, &val) != DAP_TRANSFER_OK) ||
+          (cal_transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | CAL_AP_TAR, NULL) != DAP_TRANSFER_OK) ||
+          (cal_transfer(DAP_TRANSFER_RnW | DP_RDBUFF, &val) != DAP_TRANSFER_OK) ||
+          (val != cal_ref.tar[i])) {
+        return 0U;
+      }
+    }
+  }
+  return 1U;
+}
+
+// A sample delay of delay PIO cycles at clk's divider, in clk_sys cycles
+static uint32_t cal_delay_clk_sys (const probe_clock_t *clk, uint32_t delay) {
+  return (delay * (((uint32_t)clk->div_int << 8) | clk->div_frac) + 255U) >> 8;
+}
+
+// Try every sample delay at one rate
+//   return: bitmap of the delays that passed, in PIO cycles, or -1 if the
+//           target was lost
+static int32_t cal_sweep (uint32_t freq) {
+  probe_clock_t clk;
+  int32_t pass = 0;
+  uint32_t delay;
+
+  probe_plan_swclk(freq, &clk);
+  for (delay = 0U; delay <= clk.cycles / 2U; delay++) {
+    SWJ_SetClock(freq);
+    probe_set_sample_delay(cal_delay_clk_sys(&clk, delay));
+    if (cal_trial()) {
+      pass |= 1 << delay;
+    } else if (!cal_recover()) {
+      return -1;
+    }
+  }
+  return pass;
+}
+
+// Middle of the longest run of passing delays
+static uint32_t cal_pick_delay (int32_t pass) {
+  uint32_t best = 0U, best_len = 0U;
+  uint32_t start = 0U, len = 0U;
+  uint32_t delay;
+
+  for (delay = 0U; delay < 32U; delay++) {
+    if (pass & (1 << delay)) {
+      if (len++ == 0U) {
+        start = delay;
+      }
+      if (len > best_len) {
+        best = start + (len - 1U) / 2U;
+        best_len = len;
+      }
+    } else {
+      len = 0U;
+    }
+  }
+  return best;
+}
+
+static uint8_t cal_run (void) {
+  uint32_t clk_sys_freq = clock_get_hz(clk_sys);
+  probe_clock_t clk;
+  uint32_t i, margin = 0U;
+  uint32_t freq;
+  int32_t pass;
+
+  if (!cal_reference()) {
+    return 0U;
+  }
+
+  for (i = 0U; i < count_of(cal_periods); i++) {
+    /* Rounded up, so that SWJ_SetClock() plans this very period rather
+     * than the next one down */
+    freq = DIV_ROUND_UP(clk_sys_freq, cal_periods[i]);
+    if (freq <= CAL_REF_CLOCK) {
+      break;
+    }
+    pass = cal_sweep(freq);
+    if (pass < 0) {
+      return 0U;
+    }
+    if (pass == 0) {
+      continue;
+    }
+    /* Fastest passing rate found - step down by the margin, the slower
+     * rate still having to pass in its own right */
+    if (margin++ < PROBE_CALIBRATE_MARGIN) {
+      continue;
+    }
+    probe_plan_swclk(freq, &clk);
+    cal_result.freq_hz = clk.freq_hz;
+    cal_result.sample_delay = cal_delay_clk_sys(&clk, cal_pick_delay(pass));
+    return 1U;
+  }
+
+  cal_result.freq_hz = CAL_REF_CLOCK;
+  cal_result.sample_delay = PROBE_SAMPLE_DELAY;
+  return 1U;
+}
+
+// Calibrate SWCLK and the sample delay against the connected target
+//   return: DAP_OK, or DAP_ERROR if the target did not answer
+uint8_t SWD_Calibrate (void) {
+  uint8_t saved_turnaround = DAP_Data.swd_conf.turnaround;
+  uint8_t saved_data_phase = DAP_Data.swd_conf.data_phase;
+  uint8_t saved_idle = DAP_Data.transfer.idle_cycles;
+  uint32_t saved_clock = SWJ_GetClock();
+  uint8_t ok;
+
+  DAP_Data.swd_conf.turnaround = 1U;
+  DAP_Data.swd_conf.data_phase = 0U;
+  DAP_Data.transfer.idle_cycles = 0U;
+  SWD_Configure();
+  SWJ_SetClockLimit(0U);
+
+  ok = cal_run();
+  cal_result.status = ok ? DAP_OK : DAP_ERROR;
+  if (ok) {
+    SWJ_SetClockLimit(cal_result.freq_hz);
+    probe_set_sample_delay(cal_result.sample_delay);
+  } else {
+    probe_set_sample_delay(PROBE_SAMPLE_DELAY);
+  }
+  probe_info("SWD calibration %s: %luHz, sample +%d\n", ok ? "done" : "failed",
+             (unsigned long)cal_result.freq_hz, cal_result.sample_delay);
+
+  DAP_Data.swd_conf.turnaround = saved_turnaround;
+  DAP_Data.swd_conf.data_phase = saved_data_phase;
+  DAP_Data.transfer.idle_cycles = saved_idle;
+  SWD_Configure();
+  SWJ_SetClock(saved_clock);
+  return cal_result.status;
+}
+
+void SWD_SetCalibrateOnConnect (uint8_t enable) {
+  calibrate_on_connect = enable;
+  if (!enable) {
+    SWJ_SetClockLimit(0U);
+  }
+}
+
+void SWD_CalibrateOnConnect (void) {
+  if (calibrate_on_connect) {
+    SWD_Calibrate();
+  }
+}
+
+const probe_calibration_t *SWD_GetCalibration (void) {
+  return &cal_result;
+}
+
+#endif  /* (DAP_SWD != 0) */
@@ -23,16 +23,62 @@
  * hand off the bit sequences to a SM for asynchronous completion.
  */
 
+#include <assert.h>
 #include <stdio.h>
 
 #include "DAP_config.h"
 #include "DAP.h"
 #include "probe.h"
+#include "sw_dp_pio.h"
 
-/* Slight hack - we're not bitbashing so we need to set baudrate off the DAP's delay cycles.
- * Ideally we don't want calls to udiv everywhere... */
-#define MAKE_KHZ(x) (CPU_CLOCK / (2000 * ((x) + 1)))
-volatile uint32_t cached_delay = 0;
+/* We're not bitbashing, so SWCLK is set from the frequency DAP_SWJ_Clock asked
+ * for rather than the DAP's delay cycles. cached_clock is what was last
+ * programmed into the PIO, PORT_SWD_SETUP clears it after a probe_init(). */
+static uint32_t swj_clock = DAP_DEFAULT_SWJ_CLOCK;
+static uint32_t swj_clock_limit = 0U;
+volatile uint32_t cached_clock = 0;
+
+// Requested clock, held under the calibrated ceiling
+static inline uint32_t swj_clock_used (uint32_t clock) {
+  if (swj_clock_limit && (clock > swj_clock_limit)) {
+    return swj_clock_limit;
+  }
+  return clock;
+}
+
+static inline void swd_update_clock (void) {
+  uint32_t clock = swj_clock_used(swj_clock);
+
+  if (clock != cached_clock) {
+    probe_set_swclk_freq(clock);
+    cached_clock = clock;
+  }
+}
+
+// Set SWJ Clock
+//   clock:  requested SWCLK frequency in Hz
+//   return: frequency that will be used, never above the request
+uint32_t SWJ_SetClock (uint32_t clock) {
+  probe_clock_t clk;
+
+  swj_clock = clock;
+  probe_plan_swclk(swj_clock_used(clock), &clk);
+  return clk.freq_hz;
+}
+
+uint32_t SWJ_GetClock (void) {
+  return swj_clock;
+}
+
+// The SWCLK setting the next transfer will run at. The probe itself only
+// takes a new clock up then, so probe_get_swclk() can still be the old one.
+void SWJ_GetClockPlan (probe_clock_t *clk) {
+  probe_plan_swclk(swj_clock_used(swj_clock), clk);
+}
+
+void SWJ_SetClockLimit (uint32_t clock) {
+  swj_clock_limit = clock;
+}
 
 // Generate SWJ Sequence
 //   count:  sequence bit count
@@ -40,23 +86,11 @@ volatile uint32_t cached_delay = 0;
 //   return: none
 #if ((DAP_SWD != 0) || (DAP_JTAG != 0))
 void SWJ_Sequence (uint32_t count, const uint8_t *data) {
-  uint32_t bits;
-  uint32_t n;
-
-  if (DAP_Data.clock_delay != cached_delay) {
-    probe_set_swclk_freq(MAKE_KHZ(DAP_Data.clock_delay));
-    cached_delay = DAP_Data.clock_delay;
-  }
+  swd_update_clock();
   probe_debug("SWJ sequence count = %d FDB=0x%2x\n", count, data[0]);
-  n = count;
-  while (n > 0) {
-    if (n > 8)
-      bits = 8;
-    else
-      bits = n;
-    probe_write_bits(bits, *data++);
-    n -= bits;
-  }
+  /* Up to 256 bits - a single command, 32 bits per data entry */
+  probe_stream_write_buf(count, data);
+  probe_stream_run();
 }
 #endif
 
@@ -67,69 +101,111 @@ void SWJ_Sequence (uint32_t count, const uint8_t *data) {
 //   return: none
 #if (DAP_SWD != 0)
 void SWD_Sequence (uint32_t info, const uint8_t *swdo, uint8_t *swdi) {
-  uint32_t bits;
   uint32_t n;
+  uint index;
 
-  if (DAP_Data.clock_delay != cached_delay) {
-    probe_set_swclk_freq(MAKE_KHZ(DAP_Data.clock_delay));
-    cached_delay = DAP_Data.clock_delay;
-  }
+  swd_update_clock();
   probe_debug("SWD sequence\n");
   n = info & SWD_SEQUENCE_CLK;
   if (n == 0U) {
     n = 64U;
   }
-  bits = n;
   if (info & SWD_SEQUENCE_DIN) {
-    while (n > 0) {
-      if (n > 8)
-        bits = 8;
-      else
-        bits = n;
-      *swdi++ = probe_read_bits(bits);
-      n -= bits;
-    }
+    index = probe_stream_read_bits(n);
+    probe_stream_run();
+    probe_stream_read_buf(index, n, swdi);
   } else {
-    while (n > 0) {
-      if (n > 8)
-        bits = 8;
-      else
-        bits = n;
-      probe_write_bits(bits, *swdo++);
-      n -= bits;
-    }
+    probe_stream_write_buf(n, swdo);
+    probe_stream_run();
   }
 }
 #endif
 
 #if (DAP_SWD != 0)
-// SWD Transfer I/O
-//   request: A[3:2] RnW APnDP
-//   data:    DATA[31:0]
-//   return:  ACK[2:0]
-uint8_t SWD_Transfer (uint32_t request, uint32_t *data) {
-  uint8_t prq = 0;
-  uint8_t ack;
-  uint8_t bit;
-  uint32_t val = 0;
-  uint32_t parity = 0;
+// Request packets for A[3:2] RnW APnDP: start, APnDP, RnW, A[3:2], parity,
+// stop, park
+static const uint8_t swd_request_table[16] = {
+  0x81, 0xA3, 0xA5, 0x87, 0xA9, 0x8B, 0x8D, 0xAF,
+  0xB1, 0x93, 0x95, 0xB7, 0x99, 0xBB, 0xBD, 0x9F
+};
+
+static inline uint8_t swd_request_byte (uint32_t request) {
+  return swd_request_table[request & 0xFU];
+}
+
+// Queue the idle cycles after a transfer - drive 0 for N clocks
+static void swd_queue_idle (void) {
   uint32_t n;
 
-  if (DAP_Data.clock_delay != cached_delay) {
-    probe_set_swclk_freq(MAKE_KHZ(DAP_Data.clock_delay));
-    cached_delay = DAP_Data.clock_delay;
+  for (n = DAP_Data.transfer.idle_cycles; n; ) {
+    if (n > 256) {
+      probe_stream_write_bits(256, 0);
+      n -= 256;
+    } else {
+      probe_stream_write_bits(n, 0);
+      n -= n;
+    }
   }
-  probe_debug("SWD_transfer\n");
-  /* Generate the request packet */
-  prq |= (1 << 0); /* Start Bit */
-  for (n = 1; n < 5; n++) {
-    bit = (request >> (n - 1)) & 0x1;
-    prq |= bit << n;
-    parity += bit;
-  }
-  prq |= (parity & 0x1) << 5; /* Parity Bit */
-  prq |= (0 << 6); /* Stop Bit */
-  prq |= (1 << 7); /* Park bit */
+}
+
+// Queue the data phase and idle cycles of an SWD transfer on the command stream
+//   request: A[3:2] RnW APnDP
+//   wdata:   DATA[31:0] for writes
+//   return:  stream index of RDATA, followed by its parity bit
+static uint swd_queue_data_phase (uint32_t request, uint32_t wdata) {
+  uint rdata = 0U;
+
+  if (request & DAP_TRANSFER_RnW) {
+    /* Read RDATA[0:31] + Parity, then turnaround for line idle */
+    rdata = probe_stream_read_bits(32);
+    probe_stream_read_bits(1);
+    probe_stream_hiz_clocks(DAP_Data.swd_conf.turnaround);
+  } else {
+    /* Turnaround for write, then WDATA[0:31] + Parity */
+    probe_stream_hiz_clocks(DAP_Data.swd_conf.turnaround);
+    probe_stream_write_bits(32, wdata);
+    probe_stream_write_bits(1, __builtin_popcount(wdata) & 0x1);
+  }
+
+  swd_queue_idle();
+  return rdata;
+}
+
+// Idle cycles clocked between WAIT retries
+static uint32_t wait_backoff = 0U;
+
+// WAIT retries: total, and for the last transfer
+static uint32_t wait_retries_total = 0U;
+static uint32_t wait_retries_last = 0U;
+
+void SWD_SetWaitBackoff (uint32_t cycles) {
+  wait_backoff = cycles;
+}
+
+uint32_t SWD_GetWaitRetries (uint32_t *last) {
+  if (last)
+    *last = wait_retries_last;
+  return wait_retries_total;
+}
+
+// Idle cycles - drive 0 for N clocks
+static void swd_idle (uint32_t n) {
+  while (n) {
+    if (n > 256) {
+      probe_write_bits(256, 0);
+      n -= 256;
+    } else {
+      probe_write_bits(n, 0);
+      n -= n;
+    }
+  }
+}
+
+// Request and ACK phase with the ACK checked by the CPU. Anything but OK
+// is finished off here.
+static uint8_t swd_request (uint8_t prq, uint32_t request) {
+  uint8_t ack;
+
   probe_write_bits(8, prq);
 
   /* Turnaround (ignore read bits) */
@@ -137,52 +213,6 @@ uint8_t SWD_Transfer (uint32_t request, uint32_t *data) {
   ack >>= DAP_Data.swd_conf.turnaround;
 
   if (ack == DAP_TRANSFER_OK) {
-    /* Data transfer phase */
-    if (request & DAP_TRANSFER_RnW) {
-      /* Read RDATA[0:31] - note probe_read shifts to LSBs */
-      val = probe_read_bits(32);
-      bit = probe_read_bits(1);
-      parity = __builtin_popcount(val);
-      if ((parity ^ bit) & 1U) {
-        /* Parity error */
-        ack = DAP_TRANSFER_ERROR;
-      }
-      if (data)
-        *data = val;
-      probe_debug("Read %02x ack %02x 0x%08x parity %01x\n",
-                      prq, ack, val, bit);
-      /* Turnaround for line idle */
-      probe_hiz_clocks(DAP_Data.swd_conf.turnaround);
-    } else {
-      /* Turnaround for write */
-      probe_hiz_clocks(DAP_Data.swd_conf.turnaround);
-
-      /* Write WDATA[0:31] */
-      val = *data;
-      probe_write_bits(32, val);
-      parity = __builtin_popcount(val);
-      /* Write Parity Bit */
-      probe_write_bits(1, parity & 0x1);
-      probe_debug("write %02x ack %02x 0x%08x parity %01x\n",
-                      prq, ack, val, parity);
-    }
-    /* Capture Timestamp */
-    if (request & DAP_TRANSFER_TIMESTAMP) {
-      DAP_Data.timestamp = time_us_32();
-    }
-
-    /* Idle cycles - drive 0 for N clocks */
-    if (DAP_Data.transfer.idle_cycles) {
-      for (n = DAP_Data.transfer.idle_cycles; n; ) {
-        if (n > 256) {
-          probe_write_bits(256, 0);
-          n -= 256;
-        } else {
-          probe_write_bits(n, 0);
-          n -= n;
-        }
-      }
-    }
     return ((uint8_t)ack);
   }
 
@@ -201,10 +231,447 @@ uint8_t SWD_Transfer (uint32_t request, uint32_t *data) {
   }
 
   /* Protocol error */
-  n = DAP_Data.swd_conf.turnaround + 32U + 1U;
   /* Back off data phase */
-  probe_read_bits(n);
+  probe_read_bits(DAP_Data.swd_conf.turnaround + 32U + 1U);
   return ((uint8_t)ack);
 }
 
+// Last value written to DP SELECT, for the bank checks of blind writes
+static uint32_t swd_select = 0U;
+static uint8_t swd_select_valid = 0U;
+
+// Transfers submitted and not yet completed. Those the PIO txn routine can
+// run - single-cycle turnaround, no forced data phase - are queued on the
+// command stream behind each other and complete in order as their ACKs and
+// data come back. Anything else runs through swd_request() at submission.
+static struct {
+  uint32_t request[SWD_QUEUE_DEPTH];
+  uint32_t data[SWD_QUEUE_DEPTH];       // WDATA in, RDATA out
+  uint32_t retry[SWD_QUEUE_DEPTH];      // WAIT retries allowed
+  uint     ack[SWD_QUEUE_DEPTH];        // Stream index of the ACK
+  uint     rdata[SWD_QUEUE_DEPTH];      // Stream index of RDATA and parity
+  uint8_t  result[SWD_QUEUE_DEPTH];     // ACK once completed
+  uint8_t  done[SWD_QUEUE_DEPTH];       // Completed at submission
+  uint32_t head;                        // Next slot to submit
+  uint32_t tail;                        // Next slot to complete
+} swd_queue;
+
+#define SWD_SLOT(slot)  ((slot) % SWD_QUEUE_DEPTH)
+
+static_assert(SWD_QUEUE_DEPTH * 3U <= PROBE_STREAM_READS,
+              "SWD queue holds more results than the probe stream");
+
+// How transfers are put on the wire, chosen by SWD_Configure() from the
+// turnaround, data phase and idle cycle settings
+enum {
+  SWD_PATH_FAST,        // Txn routine, turnaround 1, no idle cycles
+  SWD_PATH_TXN,         // Txn routine, turnaround 1, idle cycles
+  SWD_PATH_DISCRETE     // ACK checked by the CPU
+};
+static uint8_t swd_path = SWD_PATH_FAST;
+
+// Select the transfer path for the current SWD configuration. To be called
+// whenever the turnaround, data phase or idle cycles change.
+void SWD_Configure (void) {
+  if ((DAP_Data.swd_conf.turnaround != 1U) || (DAP_Data.swd_conf.data_phase != 0U)) {
+    swd_path = SWD_PATH_DISCRETE;
+  } else if (DAP_Data.transfer.idle_cycles != 0U) {
+    swd_path = SWD_PATH_TXN;
+  } else {
+    swd_path = SWD_PATH_FAST;
+  }
+}
+
+// Queue a transfer in full on the command stream
+static void swd_queue_txn (uint32_t slot) {
+  uint32_t i = SWD_SLOT(slot);
+  uint32_t request = swd_queue.request[i];
+
+  swd_queue.ack[i] = probe_stream_txn(swd_request_byte(request));
+  if (swd_path != SWD_PATH_FAST) {
+    swd_queue.rdata[i] = swd_queue_data_phase(request, swd_queue.data[i]);
+  } else if (request & DAP_TRANSFER_RnW) {
+    /* RDATA[0:31] and parity, one cycle turnaround */
+    swd_queue.rdata[i] = probe_stream_read_bits(32U + 1U);
+    probe_stream_hiz_clocks(1U);
+  } else {
+    /* One cycle turnaround, WDATA[0:31] and parity */
+    probe_stream_hiz_clocks(1U);
+    probe_stream_write_parity(swd_queue.data[i]);
+  }
+}
+
+// Request, ACK and data phase with the ACK checked by the CPU, for the
+// configurations the txn routine does not cover
+static uint8_t swd_transfer_discrete (uint32_t request, uint32_t *data, uint32_t retry) {
+  uint8_t prq = swd_request_byte(request);
+  uint8_t ack;
+  uint8_t bit;
+  uint32_t val;
+  uint32_t retries = 0U;
+  uint rdata;
+
+  ack = swd_request(prq, request);
+  while ((ack == DAP_TRANSFER_WAIT) && retry-- && !DAP_TransferAbort) {
+    retries++;
+    swd_idle(wait_backoff);
+    ack = swd_request(prq, request);
+  }
+  wait_retries_last = retries;
+  wait_retries_total += retries;
+  if (ack != DAP_TRANSFER_OK) {
+    return ack;
+  }
+
+  rdata = swd_queue_data_phase(request, *data);
+  probe_stream_run();
+  if (request & DAP_TRANSFER_RnW) {
+    val = probe_stream_result(rdata);
+    bit = probe_stream_result(rdata + 1);
+    if ((__builtin_popcount(val) ^ bit) & 1U) {
+      /* Parity error */
+      ack = DAP_TRANSFER_ERROR;
+    }
+    *data = val;
+  }
+  return ack;
+}
+
+// Complete the oldest submitted transfer. A WAIT is retried by cancelling
+// everything queued from it on and queueing it all again. Any other failure
+// cancels the transfers behind it, which complete with the same ACK.
+static void swd_complete_next (void) {
+  uint32_t slot = swd_queue.tail;
+  uint32_t i = SWD_SLOT(slot);
+  uint32_t request = swd_queue.request[i];
+  uint32_t retries = 0U;
+  uint32_t val;
+  uint8_t ack;
+  uint8_t bit;
+
+  if (swd_queue.done[i]) {
+    ack = swd_queue.result[i];
+    goto done;
+  }
+
+  ack = probe_stream_result(swd_queue.ack[i]);
+  while ((ack == DAP_TRANSFER_WAIT) && (retries < swd_queue.retry[i]) && !DAP_TransferAbort) {
+    retries++;
+    probe_stream_cancel();
+    swd_idle(wait_backoff);
+    for (uint32_t n = slot; n != swd_queue.head; n++) {
+      swd_queue_txn(n);
+    }
+    probe_stream_run();
+    ack = probe_stream_result(swd_queue.ack[i]);
+  }
+  wait_retries_last = retries;
+  wait_retries_total += retries;
+
+  if (ack != DAP_TRANSFER_OK) {
+    probe_stream_cancel();
+    if ((ack != DAP_TRANSFER_WAIT) && (ack != DAP_TRANSFER_FAULT)) {
+      /* Protocol error - back off the rest of the data phase */
+      probe_read_bits(32U + 1U);
+    }
+    for (uint32_t n = slot + 1U; n != swd_queue.head; n++) {
+      swd_queue.result[SWD_SLOT(n)] = ack;
+    }
+    swd_queue.result[i] = ack;
+    swd_queue.tail = swd_queue.head;
+    return;
+  }
+
+  if (request & DAP_TRANSFER_RnW) {
+    val = probe_stream_result(swd_queue.rdata[i]);
+    bit = probe_stream_result(swd_queue.rdata[i] + 1);
+    if ((__builtin_popcount(val) ^ bit) & 1U) {
+      /* Parity error */
+      ack = DAP_TRANSFER_ERROR;
+    }
+    swd_queue.data[i] = val;
+    probe_debug("Read %02x ack %02x 0x%08x parity %01x\n",
+                    swd_request_byte(request), ack, val, bit);
+  } else {
+    probe_debug("write %02x ack %02x 0x%08x parity %01x\n",
+                    swd_request_byte(request), ack, swd_queue.data[i],
+                    __builtin_popcount(swd_queue.data[i]) & 0x1);
+  }
+
+done:
+  if (ack == DAP_TRANSFER_OK) {
+    if ((request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | DAP_TRANSFER_A2 | DAP_TRANSFER_A3)) == DP_SELECT) {
+      swd_select = swd_queue.data[i];
+      swd_select_valid = 1U;
+    }
+    /* Capture Timestamp */
+    if (request & DAP_TRANSFER_TIMESTAMP) {
+      DAP_Data.timestamp = time_us_32();
+    }
+  }
+  swd_queue.result[i] = ack;
+  swd_queue.tail++;
+}
+
+static uint32_t swd_submit (uint32_t request, uint32_t data, uint32_t retry) {
+  uint32_t slot = swd_queue.head;
+  uint32_t i = SWD_SLOT(slot);
+
+  /* The slot about to be reused has to be complete */
+  if (slot - swd_queue.tail >= SWD_QUEUE_DEPTH) {
+    swd_complete_next();
+  }
+  swd_update_clock();
+
+  swd_queue.request[i] = request;
+  swd_queue.data[i] = data;
+  swd_queue.retry[i] = retry;
+  if (swd_path != SWD_PATH_DISCRETE) {
+    swd_queue.done[i] = 0U;
+    swd_queue.head++;
+    swd_queue_txn(slot);
+    probe_stream_run();
+  } else {
+    /* Ordered behind everything submitted before */
+    while (swd_queue.tail != slot) {
+      swd_complete_next();
+    }
+    swd_queue.done[i] = 1U;
+    swd_queue.result[i] = swd_transfer_discrete(request, &swd_queue.data[i], retry);
+    swd_queue.head++;
+  }
+  return slot;
+}
+
+// Submit an SWD transfer without waiting for it. WAIT is retried as for
+// SWD_TransferRetry().
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0] for writes
+//   return:  slot to complete it by
+uint32_t SWD_Submit (uint32_t request, uint32_t data) {
+  return swd_submit(request, data, DAP_Data.transfer.retry_count);
+}
+
+// Wait for a submitted transfer, and every one before it. Only the last
+// SWD_QUEUE_DEPTH submitted can be completed.
+//   slot:    from SWD_Submit()
+//   data:    DATA[31:0] for reads, may be NULL
+//   return:  ACK[2:0], with DAP_TRANSFER_ERROR for a parity error
+uint8_t SWD_Complete (uint32_t slot, uint32_t *data) {
+  uint32_t i = SWD_SLOT(slot);
+
+  while ((int32_t)(swd_queue.tail - slot) <= 0) {
+    swd_complete_next();
+  }
+  if (data && (swd_queue.request[i] & DAP_TRANSFER_RnW)) {
+    *data = swd_queue.data[i];
+  }
+  return swd_queue.result[i];
+}
+
+// SWD Transfer I/O, retrying WAIT up to retry times
+static uint8_t swd_transfer (uint32_t request, uint32_t *data, uint32_t retry) {
+  uint32_t slot;
+
+  probe_debug("SWD_transfer\n");
+  slot = swd_submit(request, ((request & DAP_TRANSFER_RnW) == 0U) ? *data : 0U, retry);
+  return SWD_Complete(slot, data);
+}
+
+// SWD Transfer I/O
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  ACK[2:0]
+uint8_t SWD_Transfer (uint32_t request, uint32_t *data) {
+  return swd_transfer(request, data, 0U);
+}
+
+// SWD Transfer I/O with WAIT handled by the engine, up to the configured
+// retry count and with the configured idle backoff between attempts
+//   request: A[3:2] RnW APnDP
+//   data:    DATA[31:0]
+//   return:  final ACK[2:0]
+uint8_t SWD_TransferRetry (uint32_t request, uint32_t *data) {
+  return swd_transfer(request, data, DAP_Data.transfer.retry_count);
+}
+
+// DP CTRL/STAT and ABORT bits used around blind writes
+#define DP_CTRL_ORUNDETECT    0x00000001U
+#define DP_CTRL_STICKYORUN    0x00000002U
+#define DP_CTRL_STICKYCMP     0x00000010U
+#define DP_CTRL_STICKYERR     0x00000020U
+#define DP_CTRL_WDATAERR      0x00000080U
+#define DP_CTRL_STICKY        (DP_CTRL_STICKYORUN | DP_CTRL_STICKYCMP | \
+                               DP_CTRL_STICKYERR | DP_CTRL_WDATAERR)
+#define DP_ABORT_STKERRCLR    0x00000004U
+#define DP_ABORT_WDERRCLR     0x00000008U
+#define DP_ABORT_ORUNERRCLR   0x00000010U
+
+// Shortest block worth the CTRL/STAT accesses around it
+#define SWD_BLIND_MIN         4U
+// Stream entries per blind write: request, ACK, data and parity, idle cycles
+#define SWD_BLIND_WORDS       8U
+#define SWD_BLIND_CHUNK       MIN(PROBE_STREAM_READS, PROBE_STREAM_WORDS / SWD_BLIND_WORDS)
+
+static uint8_t blind_writes = PROBE_SWD_BLIND_WRITES;
+
+void SWD_SetBlindWrites (uint8_t enable) {
+  blind_writes = enable;
+}
+
+// Queue a write with its data phase clocked whatever the ACK, as the DP
+// expects with ORUNDETECT set
+//   return: stream index of the turnaround and ACK bits
+static uint swd_queue_blind_write (uint8_t prq, uint32_t wdata) {
+  uint8_t buf[5];
+  uint ack;
+
+  buf[0] = (uint8_t)(wdata >>  0);
+  buf[1] = (uint8_t)(wdata >>  8);
+  buf[2] = (uint8_t)(wdata >> 16);
+  buf[3] = (uint8_t)(wdata >> 24);
+  buf[4] = __builtin_popcount(wdata) & 0x1;
+
+  probe_stream_write_bits(8, prq);
+  /* Turnaround, ACK[0:2], turnaround - SWDIO released throughout */
+  ack = probe_stream_read_bits(2U * DAP_Data.swd_conf.turnaround + 3U);
+  probe_stream_write_buf(33, buf);
+  swd_queue_idle();
+  return ack;
+}
+
+// Clear an overrun. STICKYERR and WDATAERR are left for the host to see.
+static void swd_clear_overrun (void) {
+  uint32_t val = DP_ABORT_ORUNERRCLR;
+
+  SWD_Transfer(DP_ABORT, &val);
+}
+
+// Write an AP register block without waiting on each ACK. ORUNDETECT is set
+// for the block, so a WAIT or FAULT makes the DP ignore every access after it
+// while the data phases keep the line in step. The ACKs are checked once the
+// block has gone out, the overrun cleared, and the caller carries on from the
+// first write that was not accepted.
+//
+// A bus or write data error leaves STICKYERR or WDATAERR set, and the DP then
+// faults the CTRL/STAT write that turns ORUNDETECT off. Those are cleared too
+// so that ORUNDETECT is never left on, and the error is reported as a FAULT
+// at the write it was seen on, as it would be without blind writes. The host
+// finds the FAULT but not the sticky flags behind it.
+//   request: A[3:2] RnW APnDP
+//   data:    write data, little-endian
+//   count:   number of words on entry, number written on return
+//   return:  DAP_TRANSFER_OK, also after an overrun, DAP_TRANSFER_FAULT after
+//            a bus or write data error, or a protocol error ACK
+uint8_t SWD_TransferBlind (uint32_t request, const uint8_t *data, uint32_t *count) {
+  uint32_t ctrl, val;
+  uint32_t done = 0U;
+  uint32_t chunk, i;
+  uint32_t retry, error;
+  uint8_t saved_data_phase;
+  uint8_t prq;
+  uint8_t ack = DAP_TRANSFER_OK;
+  uint first = 0;
+
+  /* CTRL/STAT is only at DP address 0x4 with DPBANKSEL 0 */
+  if (!blind_writes || (*count < SWD_BLIND_MIN) ||
+      ((request & (DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW)) != DAP_TRANSFER_APnDP) ||
+      !swd_select_valid || ((swd_select & 0xFU) != 0U)) {
+    *count = 0U;
+    return DAP_TRANSFER_OK;
+  }
+  /* Left to the slow path to try, and report, if this much fails */
+  if ((SWD_TransferRetry(DAP_TRANSFER_RnW | DP_CTRL_STAT, &ctrl) != DAP_TRANSFER_OK)) {
+    *count = 0U;
+    return DAP_TRANSFER_OK;
+  }
+  ctrl &= ~DP_CTRL_STICKY;
+  val = ctrl | DP_CTRL_ORUNDETECT;
+  if (SWD_TransferRetry(DP_CTRL_STAT, &val) != DAP_TRANSFER_OK) {
+    *count = 0U;
+    return DAP_TRANSFER_OK;
+  }
+  /* From here every WAIT or FAULT needs its data phase */
+  saved_data_phase = DAP_Data.swd_conf.data_phase;
+  DAP_Data.swd_conf.data_phase = 1U;
+  SWD_Configure();
+
+  swd_update_clock();
+  prq = swd_request_byte(request);
+  while ((done < *count) && (ack == DAP_TRANSFER_OK) && !DAP_TransferAbort) {
+    chunk = MIN(*count - done, SWD_BLIND_CHUNK);
+    for (i = 0U; i < chunk; i++) {
+      val = (uint32_t)(*(data+0) <<  0) |
+            (uint32_t)(*(data+1) <<  8) |
+            (uint32_t)(*(data+2) << 16) |
+            (uint32_t)(*(data+3) << 24);
+      data += 4;
+      if (i == 0U) {
+        first = swd_queue_blind_write(prq, val);
+      } else {
+        swd_queue_blind_write(prq, val);
+      }
+    }
+    probe_stream_run();
+    for (i = 0U; i < chunk; i++) {
+      ack = (probe_stream_result(first + i) >> DAP_Data.swd_conf.turnaround) & 0x7U;
+      if (ack != DAP_TRANSFER_OK) {
+        break;
+      }
+    }
+    done += i;
+  }
+  probe_debug("Blind write %d/%d ack %d\n", done, *count, ack);
+
+  if ((ack != DAP_TRANSFER_OK) && (ack != DAP_TRANSFER_WAIT) && (ack != DAP_TRANSFER_FAULT)) {
+    /* Protocol error - nothing more can be said about the DP's state */
+    DAP_Data.swd_conf.data_phase = saved_data_phase;
+    SWD_Configure();
+    *count = done;
+    return ack;
+  }
+
+  /* Wait for the last accepted write. A WAIT here is an overrun too. */
+  error = 0U;
+  retry = DAP_Data.transfer.retry_count;
+  do {
+    if (SWD_Transfer(DAP_TRANSFER_RnW | DP_RDBUFF, NULL) == DAP_TRANSFER_OK) {
+      break;
+    }
+    val = 0U;
+    SWD_Transfer(DAP_TRANSFER_RnW | DP_CTRL_STAT, &val);
+    error = val & (DP_CTRL_STICKYERR | DP_CTRL_WDATAERR);
+    if (error) {
+      break;
+    }
+    swd_clear_overrun();
+  } while (retry-- && !DAP_TransferAbort);
+
+  if (error) {
+    val = DP_ABORT_STKERRCLR | DP_ABORT_WDERRCLR | DP_ABORT_ORUNERRCLR;
+    SWD_Transfer(DP_ABORT, &val);
+  } else if (ack != DAP_TRANSFER_OK) {
+    swd_clear_overrun();
+  }
+
+  /* Overrun detection off again */
+  retry = DAP_Data.transfer.retry_count;
+  do {
+    val = ctrl;
+    ack = SWD_Transfer(DP_CTRL_STAT, &val);
+    if (ack == DAP_TRANSFER_OK) {
+      break;
+    }
+    swd_clear_overrun();
+  } while (retry-- && !DAP_TransferAbort);
+
+  DAP_Data.swd_conf.data_phase = saved_data_phase;
+  SWD_Configure();
+  *count = done;
+  if ((ack == DAP_TRANSFER_OK) && error) {
+    return DAP_TRANSFER_FAULT;
+  }
+  return ack;
+}
+
 #endif  /* (DAP_SWD != 0) */
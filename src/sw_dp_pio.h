@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2022 Raspberry Pi Ltd
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the License); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an AS IS BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SW_DP_PIO_H_
+#define SW_DP_PIO_H_
+
+#include <stdint.h>
+
+#include "probe.h"
+
+// Extensions to the SW_DP interface provided by the PIO shim
+
+// SWCLK frequency last requested through DAP_SWJ_Clock
+uint32_t SWJ_GetClock(void);
+// SWCLK setting, with sample delay, the next transfer will use
+void SWJ_GetClockPlan(probe_clock_t *clk);
+// Ceiling on the SWCLK frequency actually used, 0 for none
+void SWJ_SetClockLimit(uint32_t clock);
+
+// Idle cycles clocked between WAIT retries in SWD_TransferRetry()
+void SWD_SetWaitBackoff(uint32_t cycles);
+// Total WAIT retries so far, and optionally those of the last transfer
+uint32_t SWD_GetWaitRetries(uint32_t *last);
+
+// SWD transfers that can be in flight between SWD_Submit() and
+// SWD_Complete(). A read holds three results on the probe stream: ACK,
+// RDATA and parity.
+#define SWD_QUEUE_DEPTH 16U
+
+typedef struct {
+    uint32_t freq_hz;       // SWCLK ceiling found
+    uint8_t sample_delay;   // SWDIO sample delay locked in, clk_sys cycles
+    uint8_t status;         // DAP_OK, or DAP_ERROR if the target did not answer
+} probe_calibration_t;
+
+// Stream AP write blocks under DP overrun detection, see SWD_TransferBlind()
+void SWD_SetBlindWrites(uint8_t enable);
+
+// SWCLK and sample delay calibration, see sw_dp_calibrate.c
+uint8_t SWD_Calibrate(void);
+void SWD_SetCalibrateOnConnect(uint8_t enable);
+void SWD_CalibrateOnConnect(void);
+const probe_calibration_t *SWD_GetCalibration(void);
+
+#endif
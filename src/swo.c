@@ -0,0 +1,211 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <pico/stdlib.h>
+
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/clocks.h>
+
+#include "probe_config.h"
+#include "swo.h"
+
+#ifdef PROBE_SWO_PIN
+
+#include "swo.pio.h"
+
+// DMA IRQ for SWO, shared with autobaud
+#define DMA_SWO_IRQ 0
+
+/*
+ * SWO.c hands over the trace ring one block at a time, and takes the next
+ * block from the completion callback. The gap while it does so is covered by
+ * the joined 8-entry RX FIFO.
+ */
+static struct {
+    PIO pio;
+    int sm;
+    int offset;
+    int dma;
+    swo_event_cb_t cb;
+    uint32_t len;       // Length of the block being received
+    volatile bool busy;
+} swo = { .sm = -1, .offset = -1, .dma = -1 };
+
+// Sticky errors since the last look, as SWO_EVENT_ flags
+static uint32_t swo_uart_errors(void)
+{
+    uint32_t event = 0;
+    uint32_t rxstall = 1u << (PIO_FDEBUG_RXSTALL_LSB + swo.sm);
+
+    if (swo.pio->fdebug & rxstall) {
+        swo.pio->fdebug = rxstall;
+        event |= SWO_EVENT_RX_OVERFLOW;
+    }
+    if (pio_interrupt_get(swo.pio, swo.sm)) {
+        pio_interrupt_clear(swo.pio, swo.sm);
+        event |= SWO_EVENT_RX_FRAMING_ERROR;
+    }
+    return event;
+}
+
+static void __isr swo_dma_handler(void)
+{
+    if ((swo.dma < 0) || !dma_irqn_get_channel_status(DMA_SWO_IRQ, swo.dma))
+        return;
+    dma_irqn_acknowledge_channel(DMA_SWO_IRQ, swo.dma);
+    // The callback normally starts the next block straight away
+    swo.busy = false;
+    swo.cb(SWO_EVENT_RECEIVE_COMPLETE | swo_uart_errors());
+}
+
+bool swo_uart_init(swo_event_cb_t cb)
+{
+    dma_channel_config c;
+
+    if (swo.sm >= 0)
+        swo_uart_deinit();
+
+    // The probe program takes up most of pio0's instruction memory
+    swo.pio = pio1;
+    swo.sm = pio_claim_unused_sm(swo.pio, false);
+    if (swo.sm < 0)
+        return false;
+    if (!pio_can_add_program(swo.pio, &swo_uart_program)) {
+        swo_uart_deinit();
+        return false;
+    }
+    swo.offset = pio_add_program(swo.pio, &swo_uart_program);
+    swo.dma = dma_claim_unused_channel(false);
+    if (swo.dma < 0) {
+        swo_uart_deinit();
+        return false;
+    }
+    swo.cb = cb;
+    swo.busy = false;
+
+    gpio_init(PROBE_SWO_PIN);
+    gpio_pull_up(PROBE_SWO_PIN);
+    swo_uart_program_init(swo.pio, swo.sm, swo.offset, PROBE_SWO_PIN);
+
+    // One byte per FIFO entry, from the top of the word
+    c = dma_channel_get_default_config(swo.dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, pio_get_dreq(swo.pio, swo.sm, false));
+    dma_channel_configure(swo.dma, &c, NULL, (io_rw_8 *)&swo.pio->rxf[swo.sm] + 3, 0, false);
+
+    irq_add_shared_handler(dma_get_irq_num(DMA_SWO_IRQ), swo_dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(dma_get_irq_num(DMA_SWO_IRQ), true);
+    dma_irqn_set_channel_enabled(DMA_SWO_IRQ, swo.dma, true);
+    return true;
+}
+
+void swo_uart_deinit(void)
+{
+    if (swo.dma >= 0) {
+        swo_uart_abort();
+        dma_irqn_set_channel_enabled(DMA_SWO_IRQ, swo.dma, false);
+        irq_remove_handler(dma_get_irq_num(DMA_SWO_IRQ), swo_dma_handler);
+        if (!irq_has_shared_handler(dma_get_irq_num(DMA_SWO_IRQ)))
+            irq_set_enabled(dma_get_irq_num(DMA_SWO_IRQ), false);
+        dma_channel_unclaim(swo.dma);
+        swo.dma = -1;
+    }
+    if (swo.sm >= 0) {
+        pio_sm_set_enabled(swo.pio, swo.sm, false);
+        if (swo.offset >= 0)
+            pio_remove_program(swo.pio, &swo_uart_program, swo.offset);
+        pio_sm_unclaim(swo.pio, swo.sm);
+    }
+    swo.sm = swo.offset = -1;
+}
+
+uint32_t swo_uart_set_baud(uint32_t baud)
+{
+    uint32_t clk = clock_get_hz(clk_sys);
+
+    if (swo.sm < 0 || baud == 0)
+        return 0;
+    if (baud > clk / 8)
+        baud = clk / 8;
+    pio_sm_set_clkdiv(swo.pio, swo.sm, (float)clk / (8.0f * baud));
+    pio_sm_clkdiv_restart(swo.pio, swo.sm);
+    return baud;
+}
+
+void swo_uart_rx_enable(bool enable)
+{
+    if (swo.sm < 0)
+        return;
+    if (enable) {
+        pio_sm_clear_fifos(swo.pio, swo.sm);
+        pio_sm_restart(swo.pio, swo.sm);
+        pio_sm_exec(swo.pio, swo.sm, pio_encode_jmp(swo.offset));
+        swo_uart_errors();
+    }
+    pio_sm_set_enabled(swo.pio, swo.sm, enable);
+}
+
+void swo_uart_receive(uint8_t *buf, uint32_t num)
+{
+    swo.len = num;
+    swo.busy = true;
+    dma_channel_transfer_to_buffer_now(swo.dma, buf, num);
+}
+
+void swo_uart_abort(void)
+{
+    // Aborting can raise the completion IRQ anyway (RP2040-E13)
+    dma_irqn_set_channel_enabled(DMA_SWO_IRQ, swo.dma, false);
+    dma_channel_abort(swo.dma);
+    dma_irqn_acknowledge_channel(DMA_SWO_IRQ, swo.dma);
+    dma_irqn_set_channel_enabled(DMA_SWO_IRQ, swo.dma, true);
+    swo.busy = false;
+}
+
+bool swo_uart_rx_busy(void)
+{
+    return swo.busy;
+}
+
+uint32_t swo_uart_rx_count(void)
+{
+    if (!swo.busy)
+        return 0;
+    return swo.len - dma_channel_hw_addr(swo.dma)->transfer_count;
+}
+
+#endif
+
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags)
+{
+    BaseType_t woken = pdFALSE;
+
+    // Nothing to wake before the thread starts, or once USB is gone
+    if (thread_id == NULL)
+        return flags;
+    if (__get_current_exception()) {
+        xTaskNotifyFromISR(thread_id, flags, eSetBits, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTaskNotify(thread_id, flags, eSetBits);
+    }
+    return flags;
+}
+
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout)
+{
+    uint32_t value;
+    TickType_t ticks = (timeout == osWaitForever) ? portMAX_DELAY : pdMS_TO_TICKS(timeout);
+
+    (void)options;
+    if (xTaskNotifyWait(0, flags, &value, ticks) != pdTRUE)
+        return osFlagsErrorTimeout;
+    return value & flags;
+}
@@ -0,0 +1,45 @@
+/**
+ * Copyright (c) 2024 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef SWO_H
+#define SWO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* SWO in UART (NRZ) mode, received by a PIO state machine on PROBE_SWO_PIN */
+#define SWO_EVENT_RECEIVE_COMPLETE	(1u << 0)
+#define SWO_EVENT_RX_OVERFLOW		(1u << 1)
+#define SWO_EVENT_RX_FRAMING_ERROR	(1u << 2)
+
+typedef void (*swo_event_cb_t)(uint32_t event);
+
+bool swo_uart_init(swo_event_cb_t cb);
+void swo_uart_deinit(void);
+uint32_t swo_uart_set_baud(uint32_t baud);
+void swo_uart_rx_enable(bool enable);
+void swo_uart_receive(uint8_t *buf, uint32_t num);
+void swo_uart_abort(void);
+bool swo_uart_rx_busy(void);
+uint32_t swo_uart_rx_count(void);
+
+/* The few CMSIS-RTOS2 thread flag calls SWO.c makes, over task notifications */
+typedef TaskHandle_t osThreadId_t;
+
+#define osWaitForever		0xFFFFFFFFu
+#define osFlagsWaitAny		0x00000000u
+#define osFlagsErrorTimeout	0xFFFFFFFEu
+
+uint32_t osThreadFlagsSet(osThreadId_t thread_id, uint32_t flags);
+uint32_t osThreadFlagsWait(uint32_t flags, uint32_t options, uint32_t timeout);
+
+extern osThreadId_t SWO_ThreadId;
+void SWO_Thread(void *argument);
+
+#endif
@@ -66,7 +66,7 @@
 #define CFG_TUD_CDC             1
 #define CFG_TUD_MSC             0
 #define CFG_TUD_MIDI            0
-#define CFG_TUD_VENDOR          1
+#define CFG_TUD_VENDOR          0
 
 /*
  * TX bufsize (actually UART RX) is oversized because the Windows CDC-ACM
@@ -78,8 +78,10 @@
 #define CFG_TUD_CDC_RX_BUFSIZE 64
 #define CFG_TUD_CDC_TX_BUFSIZE 4096
 
-#define CFG_TUD_VENDOR_RX_BUFSIZE 8192
-#define CFG_TUD_VENDOR_TX_BUFSIZE 8192
+/*
+ * The DAP bulk interface is served by the driver in tusb_edpt_handler.c, not
+ * the vendor class, so the vendor class and its FIFOs are left out.
+ */
 
 #ifndef TUD_OPT_RP2040_USB_DEVICE_UFRAME_FIX
 #define TUD_OPT_RP2040_USB_DEVICE_UFRAME_FIX 1
@@ -4,9 +4,12 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include <assert.h>
+
 #include "tusb_edpt_handler.h"
 #include "DAP.h"
-#include "semphr.h"
+#include "dap_queue.h"
+#include "hardware/sync.h"
 
 
 static uint8_t itf_num;
@@ -15,21 +18,98 @@ static uint8_t _rhport;
 
 static uint8_t _out_ep_addr;
 static uint8_t _in_ep_addr;
+static uint16_t _in_ep_size;
+// A ZLP is on its way to end the last response
+static bool _in_zlp;
+// The IN endpoint is sending dap_fast_buf, not a ring slot
+static bool _in_fast;
+
+#if (SWO_STREAM != 0)
+/*
+ * SWO trace goes out on the interface's second bulk IN endpoint, straight from
+ * the trace ring in SWO.c, so it never waits behind DAP responses. SWO_Thread
+ * has one block at a time to hand over, and the USB task sends it. A block
+ * from before dap_thread restarted the capture is dropped - still queued, or
+ * already going out - rather than completed against the new capture.
+ */
+static uint8_t _swo_ep_addr;
+static uint8_t *swo_buf;
+static uint32_t swo_len;
+static uint32_t swo_gen;		// swo_aborts when the block was queued
+static volatile bool swo_queued;	// Set by SWO_Thread, cleared by the USB task
+static volatile uint32_t swo_aborts;	// Counted by dap_thread
+// The block on the endpoint, in the USB task
+static bool swo_busy;
+static uint32_t swo_busy_gen;
+
+static void swo_edpt_start(void);
+#endif
 
+/*
+ * Both buffers are single-producer, single-consumer rings shared between the
+ * USB task and dap_thread, which run on different cores. USBRequestBuffer is
+ * filled by the OUT endpoint and drained by dap_thread, USBResponseBuffer the
+ * other way round. Each index is written by one side only, and is published
+ * with a barrier after the slot it covers. The endpoints are only ever armed
+ * from the USB task - dap_thread hands that over with usbd_defer_func() - so
+ * wasFull and wasEmpty are only written there.
+ */
 static buffer_t USBRequestBuffer;
 static buffer_t USBResponseBuffer;
 
-static SemaphoreHandle_t edpt_spoon;
+/*
+ * RAM for both rings, split evenly between them. The layout in use only
+ * changes on a USB reset, when no transfer can be in flight.
+ */
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V2)
+#define DAP_RING_SIZE		PROBE_DAP_RING_SIZE
+#define DAP_RING_COUNT		PROBE_DAP_PACKET_COUNT
+#else
+#define DAP_RING_SIZE		(2 * DAP_PACKET_COUNT * DAP_PACKET_SIZE)
+#define DAP_RING_COUNT		DAP_PACKET_COUNT
+#endif
+static_assert(DAP_RING_COUNT >= 3 && DAP_RING_COUNT <= DAP_PACKET_COUNT &&
+	      2 * DAP_RING_COUNT * DAP_PACKET_SIZE <= DAP_RING_SIZE, "DAP ring does not fit");
+
+static uint8_t dap_ring[DAP_RING_SIZE] __attribute__((aligned(4)));
+// When each request arrived, for the latency figures in dap_stats
+static uint32_t rx_time[DAP_PACKET_COUNT];
+
+/*
+ * DAP_Info, DAP_HostStatus and DAP_SWO_Status leave the target alone, and are
+ * answered by the USB task into dap_fast_buf when nothing is ahead of them:
+ * every request so far answered by dap_thread, no batch held, and the IN
+ * endpoint idle. Otherwise they take their turn in the ring like any other
+ * command, as responses have to go back in request order.
+ */
+static uint8_t dap_fast_buf[DAP_PACKET_SIZE] __attribute__((aligned(4)));
+// Requests dap_thread has finished with, response published or held
+static volatile uint32_t dap_answered;
+
+dap_stats_t dap_stats;
+static uint8_t dap_packet_count = DAP_RING_COUNT;
+static uint16_t dap_packet_size = DAP_PACKET_SIZE;
+/*
+ * The layout for the next USB reset, set by dap_thread and taken up by the USB
+ * task. Count and size go in one word, stored and loaded whole, so a reset can
+ * never pair one layout's count with another's size.
+ */
+#define LAYOUT_PACK(count, size)	(((uint32_t)(size) << 8) | (count))
+#define LAYOUT_COUNT(layout)		((uint8_t)((layout) & 0xff))
+#define LAYOUT_SIZE(layout)		((uint16_t)((layout) >> 8))
+static volatile uint32_t next_layout = LAYOUT_PACK(DAP_RING_COUNT, DAP_PACKET_SIZE);
+
+#define SLOT_PTR(x, n) &(x.data[((n) % dap_packet_count) * dap_packet_size])
 
-#define WR_IDX(x) (x.wptr % DAP_PACKET_COUNT)
-#define RD_IDX(x) (x.rptr % DAP_PACKET_COUNT)
+#define WR_IDX(x) (x.wptr % dap_packet_count)
+#define RD_IDX(x) (x.rptr % dap_packet_count)
 
-#define WR_SLOT_PTR(x) &(x.data[WR_IDX(x)][0])
-#define RD_SLOT_PTR(x) &(x.data[RD_IDX(x)][0])
+#define WR_SLOT_PTR(x) SLOT_PTR(x, x.wptr)
+#define RD_SLOT_PTR(x) SLOT_PTR(x, x.rptr)
 
 bool buffer_full(buffer_t *buffer)
 {
-	return (buffer->wptr + 1) % DAP_PACKET_COUNT == buffer->rptr % DAP_PACKET_COUNT;
+	return buffer->wptr - buffer->rptr >= dap_packet_count - 1u;
 }
 
 bool buffer_empty(buffer_t *buffer)
@@ -37,27 +117,69 @@ bool buffer_empty(buffer_t *buffer)
 	return buffer->wptr == buffer->rptr;
 }
 
+uint16_t dap_edpt_packet_size(void)
+{
+	return dap_packet_size;
+}
+
+uint8_t dap_edpt_packet_count(void)
+{
+	return dap_packet_count;
+}
+
+static bool dap_edpt_layout_valid(uint8_t count, uint16_t size)
+{
+	return count >= 3 && count <= DAP_PACKET_COUNT &&
+	       size >= 64 && size <= DAP_PACKET_SIZE && (size % 64) == 0 &&
+	       2u * count * size <= sizeof(dap_ring);
+}
+
+// Choose the ring layout for the next USB reset. Sizes are whole full-speed
+// USB packets, and both rings have to fit in dap_ring.
+bool dap_edpt_set_layout(uint8_t count, uint16_t size)
+{
+	if (!dap_edpt_layout_valid(count, size))
+		return false;
+	next_layout = LAYOUT_PACK(count, size);
+	return true;
+}
+
+void dap_edpt_get_layout(uint8_t *count, uint16_t *size)
+{
+	uint32_t layout = next_layout;
+
+	*count = LAYOUT_COUNT(layout);
+	*size = LAYOUT_SIZE(layout);
+}
+
 // Defer setup to .reset() / .open()
 void dap_edpt_init(void) {
-	edpt_spoon = xSemaphoreCreateMutex();
-	xSemaphoreGive(edpt_spoon);
 }
 
 // This only gets called if the SOF watchdog times out
 bool dap_edpt_deinit(void)
 {
-	if (edpt_spoon != NULL)
-		vSemaphoreDelete(edpt_spoon);
-	edpt_spoon = NULL;
 	return true;
 }
 
 void dap_edpt_reset(uint8_t __unused rhport)
 {
+	uint32_t layout;
+
 	probe_info("dap_edpt_reset\n");
 	memset(&USBRequestBuffer, 0, sizeof(USBRequestBuffer));
 	memset(&USBResponseBuffer, 0, sizeof(USBResponseBuffer));
 
+	// Take up the layout chosen since the last reset, checked again as it is
+	// about to size the rings
+	layout = next_layout;
+	if (!dap_edpt_layout_valid(LAYOUT_COUNT(layout), LAYOUT_SIZE(layout)))
+		layout = LAYOUT_PACK(DAP_RING_COUNT, DAP_PACKET_SIZE);
+	dap_packet_count = LAYOUT_COUNT(layout);
+	dap_packet_size = LAYOUT_SIZE(layout);
+	USBRequestBuffer.data = &dap_ring[0];
+	USBResponseBuffer.data = &dap_ring[dap_packet_count * dap_packet_size];
+
 	//  Initialise circular buffer indices
 	USBResponseBuffer.wptr = 0;
 	USBResponseBuffer.rptr = 0;
@@ -71,6 +193,22 @@ void dap_edpt_reset(uint8_t __unused rhport)
 	USBRequestBuffer.wasEmpty = true;
 	// Linux resets us twice in succession
 
+	_in_zlp = false;
+	_in_fast = false;
+	dap_answered = 0;
+	// A DAP_QueueCommands batch cut off by the reset or unmount is dropped. Its
+	// commands have already run on the target, but the host that sent them has
+	// gone and gets none of their responses.
+	dap_queue_drop();
+
+#if (SWO_STREAM != 0)
+	// A block on the endpoint is lost to the reset. Let SWO_Thread move on to the next one.
+	if(swo_busy && swo_busy_gen == swo_aborts)
+		SWO_TransferComplete();
+	swo_busy = false;
+	_swo_ep_addr = 0;
+#endif
+
 	itf_num = 0;
 }
 
@@ -117,6 +255,13 @@ uint16_t dap_edpt_open(uint8_t __unused rhport, tusb_desc_interface_t const *itf
 	TU_VERIFY(max_len >= drv_len, 0);
 	itf_num = itf_desc->bInterfaceNumber;
 
+	/*
+	 * Transfers are a whole DAP packet, not a USB packet, so the controller rather than this driver
+	 * moves from one USB packet to the next. On RP2040 TinyUSB double-buffers bulk IN transfers of
+	 * more than one packet, but always runs OUT endpoints single-buffered, as a short packet in the
+	 * first buffer would leave the second one holding the start of the next request.
+	 */
+
 	// Initialising the OUT endpoint
 
 	tusb_desc_endpoint_t *edpt_desc = (tusb_desc_endpoint_t *) (itf_desc + 1);
@@ -126,7 +271,7 @@ uint16_t dap_edpt_open(uint8_t __unused rhport, tusb_desc_interface_t const *itf
 
 	// The OUT endpoint requires a call to usbd_edpt_xfer to initialise the endpoint, giving tinyUSB a buffer to consume when a transfer occurs at the endpoint
 	usbd_edpt_open(rhport, edpt_desc);
-	usbd_edpt_xfer(rhport, ep_addr, WR_SLOT_PTR(USBRequestBuffer), DAP_PACKET_SIZE);
+	usbd_edpt_xfer(rhport, ep_addr, WR_SLOT_PTR(USBRequestBuffer), dap_packet_size);
 
 	// Initiliasing the IN endpoint
 
@@ -134,42 +279,231 @@ uint16_t dap_edpt_open(uint8_t __unused rhport, tusb_desc_interface_t const *itf
 	ep_addr = edpt_desc->bEndpointAddress;
 
 	_in_ep_addr = ep_addr;
+	_in_ep_size = tu_edpt_packet_size(edpt_desc);
 
 	// The IN endpoint doesn't need a transfer to initialise it, as this will be done by the main loop of dap_thread
 	usbd_edpt_open(rhport, edpt_desc);
 
+#if (SWO_STREAM != 0)
+	// SWO trace, if the interface has the endpoint for it
+	if(itf_desc->bNumEndpoints > 2)
+	{
+		edpt_desc++;
+		_swo_ep_addr = edpt_desc->bEndpointAddress;
+		usbd_edpt_open(rhport, edpt_desc);
+		swo_edpt_start();
+	}
+#endif
+
 	// Spawn DAP thread?
 
 	return drv_len;
 
 }
 
+#if (SWO_STREAM != 0)
+// Send the block SWO_Thread queued, if the endpoint is free, in the USB task
+static void swo_edpt_start(void)
+{
+	if(!swo_queued || _swo_ep_addr == 0 || swo_busy)
+		return;
+	__dmb();
+	swo_queued = false;
+	if(swo_gen != swo_aborts)
+		return;
+	swo_busy = true;
+	swo_busy_gen = swo_gen;
+	usbd_edpt_xfer(_rhport, _swo_ep_addr, swo_buf, swo_len);
+}
+
+static void swo_edpt_deferred(void __unused *param)
+{
+	swo_edpt_start();
+}
+
+// From SWO_Thread
+void SWO_QueueTransfer(uint8_t *buf, uint32_t num)
+{
+	swo_buf = buf;
+	swo_len = num;
+	swo_gen = swo_aborts;
+	__dmb();
+	swo_queued = true;
+	usbd_defer_func(swo_edpt_deferred, NULL, false);
+}
+
+// From dap_thread, when the capture is restarted
+void SWO_AbortTransfer(void)
+{
+	swo_aborts++;
+	__dmb();
+}
+#endif
+
 bool dap_edpt_control_xfer_cb(uint8_t __unused rhport, uint8_t stage, tusb_control_request_t const *request)
 {
 	return false;
 }
 
+// Publish the OUT packet held back while the request buffer was full, and receive the next one
+static void dap_edpt_request_rearm(void)
+{
+	if(USBRequestBuffer.wasFull && !buffer_full(&USBRequestBuffer))
+	{
+		USBRequestBuffer.wasFull = false;
+		__dmb();
+		USBRequestBuffer.wptr++;
+#if (PROBE_DEBUG_PROTOCOL != PROTO_DAP_V1)
+		usbd_edpt_xfer(_rhport, _out_ep_addr, WR_SLOT_PTR(USBRequestBuffer), dap_packet_size);
+#endif
+		xTaskNotify(dap_taskhandle, 0, eSetValueWithOverwrite);
+	}
+}
+
+// Start the IN endpoint on the oldest response if it has nothing to send
+static void dap_edpt_response_kick(void)
+{
+	if(USBResponseBuffer.wasEmpty && !buffer_empty(&USBResponseBuffer))
+	{
+		__dmb();
+		USBResponseBuffer.wasEmpty = false;
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V1)
+		// Reports are a fixed size, whatever the length of the response in them. The HID class
+		// takes a copy, so the slot goes straight back to dap_thread.
+		if(!tud_hid_report(0, RD_SLOT_PTR(USBResponseBuffer), CFG_TUD_HID_EP_BUFSIZE))
+		{
+			USBResponseBuffer.wasEmpty = true;
+			return;
+		}
+		dap_stats.bytes_in += CFG_TUD_HID_EP_BUFSIZE;
+		__dmb();
+		USBResponseBuffer.rptr++;
+		xTaskNotify(dap_taskhandle, 0, eSetValueWithOverwrite);
+#else
+		usbd_edpt_xfer(_rhport, _in_ep_addr, RD_SLOT_PTR(USBResponseBuffer), USBResponseBuffer.data_len[RD_IDX(USBResponseBuffer)]);
+#endif
+	}
+}
+
+// Run in the USB task on behalf of dap_thread
+static void dap_edpt_deferred(void __unused *param)
+{
+	dap_edpt_request_rearm();
+	dap_edpt_response_kick();
+}
+
+// DAP_TransferAbort has to reach a transfer already running, and gets no response.
+// Raise the flag for it now, instead of queueing the packet behind it.
+static bool dap_edpt_abort_check(const uint8_t *packet)
+{
+	if(*packet != ID_DAP_TransferAbort)
+		return false;
+	DAP_TransferAbort = 1U;
+	__dmb();
+	return true;
+}
+
+// Answer a request straight away if it can go in the fast lane, in the USB task
+static bool dap_edpt_fast_check(const uint8_t *packet)
+{
+	uint16_t resp_len;
+
+	if(*packet != ID_DAP_Info && *packet != ID_DAP_HostStatus && *packet != ID_DAP_SWO_Status)
+		return false;
+	if(USBRequestBuffer.wasFull || dap_answered != USBRequestBuffer.wptr)
+		return false;
+	// The held batch and the response ring are as dap_thread left them on answering
+	__dmb();
+	if(dap_queue_held() || !USBResponseBuffer.wasEmpty || !buffer_empty(&USBResponseBuffer))
+		return false;
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V1)
+	if(!tud_hid_ready())
+		return false;
+#endif
+
+	resp_len = DAP_ProcessCommand(packet, dap_fast_buf) & 0xffff;
+	USBResponseBuffer.wasEmpty = false;
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V1)
+	tud_hid_report(0, dap_fast_buf, CFG_TUD_HID_EP_BUFSIZE);
+	dap_stats.bytes_in += CFG_TUD_HID_EP_BUFSIZE;
+#else
+	_in_fast = true;
+	usbd_edpt_xfer(_rhport, _in_ep_addr, dap_fast_buf, resp_len);
+#endif
+	return true;
+}
+
+#if (PROBE_DEBUG_PROTOCOL == PROTO_DAP_V1)
+// HID output report from the HID class, in the USB task. The class re-arms its endpoint as soon as
+// this returns, so a report that finds the request buffer full is held in the spare slot; a host
+// outrunning the packet count in DAP_Info gets any more dropped.
+void dap_hid_report_received(uint8_t const *report, uint16_t len)
+{
+	dap_stats.bytes_out += len;
+	if(USBRequestBuffer.wasFull || dap_edpt_abort_check(report) || dap_edpt_fast_check(report))
+		return;
+	memcpy(WR_SLOT_PTR(USBRequestBuffer), report, TU_MIN(len, dap_packet_size));
+	rx_time[WR_IDX(USBRequestBuffer)] = time_us_32();
+	USBRequestBuffer.wasFull = true;
+	__dmb();
+	dap_edpt_request_rearm();
+	xTaskNotify(dap_taskhandle, 0, eSetValueWithOverwrite);
+}
+
+// The last input report has gone, in the USB task
+void dap_hid_report_sent(void)
+{
+	USBResponseBuffer.wasEmpty = true;
+	__dmb();
+	dap_edpt_response_kick();
+	xTaskNotify(dap_taskhandle, 0, eSetValueWithOverwrite);
+}
+#endif
+
 // Manage USBResponseBuffer (request) write and USBRequestBuffer (response) read indices
 bool dap_edpt_xfer_cb(uint8_t __unused rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
 {
 	const uint8_t ep_dir = tu_edpt_dir(ep_addr);
 
+#if (SWO_STREAM != 0)
+	if(ep_addr == _swo_ep_addr)
+	{
+		swo_busy = false;
+		if(swo_busy_gen == swo_aborts)
+			SWO_TransferComplete();
+		swo_edpt_start();
+		return true;
+	}
+#endif
+
 	if(ep_dir == TUSB_DIR_IN)
 	{
-		if(xferred_bytes >= 0u && xferred_bytes <= DAP_PACKET_SIZE)
+		if(xferred_bytes >= 0u && xferred_bytes <= dap_packet_size)
 		{
-			xSemaphoreTake(edpt_spoon, portMAX_DELAY);
-			USBResponseBuffer.rptr++;
-			// This checks that the buffer was not empty in DAP thread, which means the next buffer was not queued up for the in endpoint callback
-			// So, queue up the buffer at the new read index, since we expect read to catch up to write at this point.
-			// It is possible for the read index to be multiple spaces behind the write index (if the USB callbacks are lagging behind dap thread),
-			// so we account for this by only setting wasEmpty to true if the next callback will empty the buffer
-			if(!USBResponseBuffer.wasEmpty)
+			dap_stats.bytes_in += xferred_bytes;
+			if(_in_zlp)
 			{
-				usbd_edpt_xfer(rhport, ep_addr, RD_SLOT_PTR(USBResponseBuffer), USBResponseBuffer.data_len[RD_IDX(USBResponseBuffer)]);
-				USBResponseBuffer.wasEmpty = (USBResponseBuffer.rptr + 1) == USBResponseBuffer.wptr;
+				_in_zlp = false;
+			} else {
+				// The slot just sent goes back to dap_thread
+				if(_in_fast)
+					_in_fast = false;
+				else
+					USBResponseBuffer.rptr++;
+				// A response ending on a full USB packet, short of a full DAP packet, needs a ZLP to end the transfer
+				if(xferred_bytes != 0 && (xferred_bytes % _in_ep_size) == 0 && xferred_bytes < dap_packet_size)
+				{
+					_in_zlp = true;
+					usbd_edpt_xfer(rhport, ep_addr, NULL, 0);
+					xTaskNotify(dap_taskhandle, 0, eSetValueWithOverwrite);
+					return true;
+				}
 			}
-			xSemaphoreGive(edpt_spoon);
+			// Queue up the next response if dap_thread has published one. If not, mark the endpoint idle so that
+			// dap_thread hands the next one over - then look again, in case it published in between and saw the flag clear.
+			USBResponseBuffer.wasEmpty = true;
+			__dmb();
+			dap_edpt_response_kick();
 			//  Wake up DAP thread after processing the callback
 			xTaskNotify(dap_taskhandle, 0, eSetValueWithOverwrite);
 			return true;
@@ -178,21 +512,29 @@ bool dap_edpt_xfer_cb(uint8_t __unused rhport, uint8_t ep_addr, xfer_result_t re
 
 	} else if(ep_dir == TUSB_DIR_OUT) {
 
-		if(xferred_bytes >= 0u && xferred_bytes <= DAP_PACKET_SIZE)
+		dap_stats.bytes_out += xferred_bytes;
+		if(xferred_bytes == 0u)
 		{
-			xSemaphoreTake(edpt_spoon, portMAX_DELAY);
-			// Only queue the next buffer in the out callback if the buffer is not full
-			// If full, we set the wasFull flag, which will be checked by dap thread
-			if(!buffer_full(&USBRequestBuffer))
-			{
-				USBRequestBuffer.wptr++;
-				usbd_edpt_xfer(rhport, ep_addr, WR_SLOT_PTR(USBRequestBuffer), DAP_PACKET_SIZE);
-				USBRequestBuffer.wasFull = false;
-			}
-			else {
-				USBRequestBuffer.wasFull = true;
-			}
-			xSemaphoreGive(edpt_spoon);
+			// A ZLP after a request of exactly dap_packet_size - receive into the same slot again
+			usbd_edpt_xfer(rhport, ep_addr, WR_SLOT_PTR(USBRequestBuffer), dap_packet_size);
+			return true;
+		}
+		if(dap_edpt_abort_check(WR_SLOT_PTR(USBRequestBuffer)) ||
+		   dap_edpt_fast_check(WR_SLOT_PTR(USBRequestBuffer)))
+		{
+			usbd_edpt_xfer(rhport, ep_addr, WR_SLOT_PTR(USBRequestBuffer), dap_packet_size);
+			return true;
+		}
+		if(xferred_bytes <= dap_packet_size)
+		{
+			// Requests larger than one USB packet end with a short packet or a ZLP.
+			// Only publish the packet and queue the next buffer if the buffer is not full.
+			// If full, we set the wasFull flag, which will be checked by dap thread once it has freed a slot -
+			// then look again, in case it freed one in between and saw the flag clear.
+			rx_time[WR_IDX(USBRequestBuffer)] = time_us_32();
+			USBRequestBuffer.wasFull = true;
+			__dmb();
+			dap_edpt_request_rearm();
 			//  Wake up DAP thread after processing the callback
 			xTaskNotify(dap_taskhandle, 0, eSetValueWithOverwrite);
 			return true;
@@ -202,73 +544,97 @@ bool dap_edpt_xfer_cb(uint8_t __unused rhport, uint8_t ep_addr, xfer_result_t re
 	return false;
 }
 
+// Wait for the IN endpoint to free a response slot, and return it
+static uint8_t *dap_response_slot(void)
+{
+	uint32_t cmd;
+
+	while(USBResponseBuffer.wptr - USBResponseBuffer.rptr >= dap_packet_count)
+		xTaskNotifyWait(0, 0xFFFFFFFFu, &cmd, portMAX_DELAY);
+	__dmb();
+	return WR_SLOT_PTR(USBResponseBuffer);
+}
+
+// Publish the response in the slot from dap_response_slot(). If the IN endpoint has gone idle,
+// the USB task needs to restart it.
+static void dap_response_publish(uint16_t resp_len)
+{
+	probe_info("%lu %lu DAP resp %s len %u\n",
+		   USBResponseBuffer.wptr, USBResponseBuffer.rptr,
+		   dap_cmd_string[*WR_SLOT_PTR(USBResponseBuffer)], resp_len);
+	USBResponseBuffer.data_len[WR_IDX(USBResponseBuffer)] = resp_len;
+	__dmb();
+	USBResponseBuffer.wptr++;
+	__dmb();
+	if(USBResponseBuffer.wasEmpty)
+		usbd_defer_func(dap_edpt_deferred, NULL, false);
+}
+
+// Hand the request slot back. If the OUT callback found the request buffer full, the USB task
+// needs to re-arm it.
+static void dap_request_release(void)
+{
+	__dmb();
+	USBRequestBuffer.rptr++;
+	__dmb();
+	if(USBRequestBuffer.wasFull)
+		usbd_defer_func(dap_edpt_deferred, NULL, false);
+}
+
+// Send a response released from a DAP_QueueCommands batch
+static void dap_held_emit(void __unused *ctx, const uint8_t *response, uint32_t len)
+{
+	memcpy(dap_response_slot(), response, len);
+	dap_response_publish(len);
+}
+
 void dap_thread(void *ptr)
 {
-	uint32_t n;
 	uint32_t cmd;
+	uint32_t start, latency;
 	uint16_t resp_len;
+	uint8_t *req;
 	do
 	{
-		// Wait for usb CB wake
-		xTaskNotifyWait(0, 0xFFFFFFFFu, &cmd, 1);
+		// Wait for usb CB wake. Every callback that hands dap_thread something to do notifies it,
+		// and a notification sent while it is busy is still pending here, so there is no need to poll.
+		xTaskNotifyWait(0, 0xFFFFFFFFu, &cmd, portMAX_DELAY);
+		dap_stats.dap_wakeups++;
 
-		while(USBRequestBuffer.rptr != USBRequestBuffer.wptr)
+		while(!buffer_empty(&USBRequestBuffer))
 		{
-			/*
-			 * Atomic command support - buffer QueueCommands, but don't process them
-			 * until a non-QueueCommands packet is seen.
-			 */
-			n = USBRequestBuffer.rptr;
-			while (USBRequestBuffer.data[n % DAP_PACKET_COUNT][0] == ID_DAP_QueueCommands) {
-				probe_info("%lu %lu DAP queued cmd %s len %02x\n",
-					       USBRequestBuffer.wptr, USBRequestBuffer.rptr,
-					       dap_cmd_string[USBRequestBuffer.data[n % DAP_PACKET_COUNT][0]], USBRequestBuffer.data[n % DAP_PACKET_COUNT][1]);
-				USBRequestBuffer.data[n % DAP_PACKET_COUNT][0] = ID_DAP_ExecuteCommands;
-				n++;
-				while (n == USBRequestBuffer.wptr) {
-					/* Need yield in a loop here, as IN callbacks will also wake the thread */
-					probe_info("DAP wait\n");
-					vTaskSuspend(dap_taskhandle);
-				}
-			}
-			// Read a single packet from the USB buffer into the DAP Request buffer
+			// Packet contents are only valid once wptr has been seen to cover them
+			__dmb();
+			req = RD_SLOT_PTR(USBRequestBuffer);
+			start = rx_time[RD_IDX(USBRequestBuffer)];
+			dap_stats.commands++;
 			probe_info("%lu %lu DAP cmd %s len %02x\n",
-					   USBRequestBuffer.wptr, USBRequestBuffer.rptr,
-					   dap_cmd_string[*RD_SLOT_PTR(USBRequestBuffer)], *(RD_SLOT_PTR(USBRequestBuffer)+1));
-
-			// If the buffer was full in the out callback, we need to queue up another buffer for the endpoint to consume, now that we know there is space in the buffer.
-			xSemaphoreTake(edpt_spoon, portMAX_DELAY); // Suspend the scheduler to safely update the write index
-			if(USBRequestBuffer.wasFull)
-			{
-				USBRequestBuffer.wptr++;
-				usbd_edpt_xfer(_rhport, _out_ep_addr, WR_SLOT_PTR(USBRequestBuffer), DAP_PACKET_SIZE);
-				USBRequestBuffer.wasFull = false;
+				   USBRequestBuffer.wptr, USBRequestBuffer.rptr,
+				   dap_cmd_string[*req], *(req+1));
+
+			if (*req == ID_DAP_QueueCommands) {
+				/*
+				 * Atomic command support - run queued commands straight away, but hold
+				 * back their responses until a non-QueueCommands packet is seen.
+				 */
+				dap_queue_hold(req, dap_packet_size, dap_held_emit, NULL);
+				dap_request_release();
+				__dmb();
+				dap_answered++;
+				continue;
 			}
-			xSemaphoreGive(edpt_spoon);
 
-			resp_len = DAP_ExecuteCommand(RD_SLOT_PTR(USBRequestBuffer), WR_SLOT_PTR(USBResponseBuffer)) & 0xffff;
-			USBRequestBuffer.rptr++;
-			probe_info("%lu %lu DAP resp %s len %u\n",
-					   USBResponseBuffer.wptr, USBResponseBuffer.rptr,
-					   dap_cmd_string[*WR_SLOT_PTR(USBResponseBuffer)], resp_len);
-
-			USBResponseBuffer.data_len[WR_IDX(USBResponseBuffer)] = resp_len;
-			//  Suspend the scheduler to avoid stale values/race conditions between threads
-			xSemaphoreTake(edpt_spoon, portMAX_DELAY);
-
-			if(buffer_empty(&USBResponseBuffer))
-			{
-				USBResponseBuffer.wptr++;
-
-				usbd_edpt_xfer(_rhport, _in_ep_addr, RD_SLOT_PTR(USBResponseBuffer), USBResponseBuffer.data_len[RD_IDX(USBResponseBuffer)]);
-			} else {
-
-				USBResponseBuffer.wptr++;
-
-				// The In callback needs to check this flag to know when to queue up the next buffer.
-				USBResponseBuffer.wasEmpty = false;
-			}
-			xSemaphoreGive(edpt_spoon);
+			// The batch, if any, is closed - its responses go first
+			dap_queue_release(dap_held_emit, NULL);
+			resp_len = DAP_ExecuteCommand(req, dap_response_slot()) & 0xffff;
+			dap_request_release();
+			dap_response_publish(resp_len);
+			dap_answered++;
+
+			latency = time_us_32() - start;
+			dap_stats.latency_total_us += latency;
+			if (latency > dap_stats.latency_max_us)
+				dap_stats.latency_max_us = latency;
 		}
 	} while (1);
 }
@@ -16,7 +16,7 @@
 #define DAP_INTERFACE_PROTOCOL 0x00
 
 typedef struct {
-	uint8_t data[DAP_PACKET_COUNT][DAP_PACKET_SIZE];
+	uint8_t *data;		// dap_packet_count slots of dap_packet_size bytes
 	uint16_t data_len[DAP_PACKET_COUNT];
 	volatile uint32_t wptr;
 	volatile uint32_t rptr;
@@ -35,6 +35,10 @@ uint16_t dap_edpt_open(uint8_t __unused rhport, tusb_desc_interface_t const *itf
 bool dap_edpt_control_xfer_cb(uint8_t __unused rhport, uint8_t stage,  tusb_control_request_t const *request);
 bool dap_edpt_xfer_cb(uint8_t __unused rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
 
+/* CMSIS-DAP v1 HID reports, through the same buffers */
+void dap_hid_report_received(uint8_t const *report, uint16_t len);
+void dap_hid_report_sent(void);
+
 /* Helper Functions */
 bool buffer_full(buffer_t *buffer);
 bool buffer_empty(buffer_t *buffer);